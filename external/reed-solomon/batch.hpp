@@ -0,0 +1,130 @@
+/* Batch encoding and decoding of many codewords of the same shape
+ *
+ * Up to kGroup codewords are transposed into a structure of arrays - byte i of every codeword side by side -
+ * so that one gf::mul_add_region works on the same position of all of them at once.
+ *
+ * See LICENSE */
+
+#ifndef RS_BATCH_HPP
+#define RS_BATCH_HPP
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "gf.hpp"
+
+namespace RS {
+
+namespace batch {
+
+/* codewords per structure-of-arrays group */
+static const size_t kGroup = 64;
+
+/* @brief Syndromes of up to kGroup codewords
+ * @param *powers - a^(k*(length-1-i)), ecc_length per codeword position i
+ * @param *src    - codewords back to back (count * length size)
+ * @param count   - number of codewords    (kGroup at most)
+ * @param *synd   - output, row k holds syndrome k of every codeword (ecc_length * count size) */
+inline void Syndromes(const uint8_t *powers, int length, int ecc_length, const uint8_t *src, size_t count, uint8_t *synd) {
+    uint8_t column[kGroup];
+
+    memset(synd, 0, ecc_length * count);
+    for(int i = 0; i < length; i++){
+        for(size_t c = 0; c < count; c++) column[c] = src[c * length + i];
+        for(int k = 0; k < ecc_length; k++){
+            gf::mul_add_region(powers[i * ecc_length + k], column, synd + k * count, count);
+        }
+    }
+}
+
+/* @brief Encoding of up to kGroup messages - the division by the generator of all of them in lockstep
+ * @param *gen - generator polynomial, highest degree first (ecc_length + 1 size)
+ * @param *src - messages back to back                      (count * msg_length size)
+ * @param count - number of messages                        (kGroup at most)
+ * @param *dst - output codewords back to back              (count * (msg_length + ecc_length) size) */
+inline void EncodeGroup(const uint8_t *gen, int msg_length, int ecc_length, const uint8_t *src, size_t count, uint8_t *dst) {
+    const int length = msg_length + ecc_length;
+    uint8_t rem[255 * kGroup];
+    uint8_t coef[kGroup];
+
+    /* row j of the remainder is at (head + j) % ecc_length - shifting it is a single increment */
+    memset(rem, 0, ecc_length * count);
+    int head = 0;
+    for(int i = 0; i < msg_length; i++){
+        uint8_t *first = rem + head * count;
+        for(size_t c = 0; c < count; c++) coef[c] = src[c * msg_length + i] ^ first[c];
+
+        memset(first, 0, count);
+        head = (head + 1) % ecc_length;
+
+        for(int j = 0; j < ecc_length; j++){
+            gf::mul_add_region(gen[j + 1], coef, rem + ((head + j) % ecc_length) * count, count);
+        }
+    }
+
+    for(size_t c = 0; c < count; c++){
+        memcpy(dst + c * length, src + c * msg_length, msg_length);
+        for(int j = 0; j < ecc_length; j++){
+            dst[c * length + msg_length + j] = rem[((head + j) % ecc_length) * count + c];
+        }
+    }
+}
+
+/* @brief Message encoding of count messages
+ * @param *gen  - generator polynomial, highest degree first (ecc_length + 1 size)
+ * @param *src  - messages back to back                      (count * msg_length size)
+ * @param *dst  - output codewords back to back              (count * (msg_length + ecc_length) size) */
+inline void Encode(const uint8_t *gen, int msg_length, int ecc_length, const uint8_t *src, uint8_t *dst, size_t count) {
+    const int length = msg_length + ecc_length;
+    for(size_t first = 0; first < count; first += kGroup){
+        size_t n = (count - first < kGroup) ? count - first : kGroup;
+        EncodeGroup(gen, msg_length, ecc_length, src + first * msg_length, n, dst + first * length);
+    }
+}
+
+/* @brief Message decoding of count codewords - codewords with zero syndromes are copied out,
+ *        only the rest go through the single codeword decoder
+ * @param *powers - a^(k*(length-1-i)), ecc_length per codeword position i
+ * @param *src    - encoded messages back to back (count * (msg_length + ecc_length) size)
+ * @param *dst    - output buffer                 (count * msg_length size at least)
+ * @param *result - 0 or the error code of every codeword (count size, may be NULL)
+ * @param decode  - int(const uint8_t *codeword, uint8_t *msg), the single codeword decoder
+ * @return number of codewords that failed to decode */
+template<typename Decoder>
+inline size_t Decode(const uint8_t *powers, int msg_length, int ecc_length, const uint8_t *src, uint8_t *dst,
+                     size_t count, int *result, Decoder decode) {
+    const int length = msg_length + ecc_length;
+    uint8_t synd[255 * kGroup];
+    uint8_t dirty[kGroup];
+    size_t n_failed = 0;
+
+    for(size_t first = 0; first < count; first += kGroup){
+        size_t n = (count - first < kGroup) ? count - first : kGroup;
+        const uint8_t *cw = src + first * length;
+        Syndromes(powers, length, ecc_length, cw, n, synd);
+
+        memset(dirty, 0, n);
+        for(int k = 0; k < ecc_length; k++){
+            for(size_t c = 0; c < n; c++) dirty[c] |= synd[k * n + c];
+        }
+
+        for(size_t c = 0; c < n; c++){
+            int res = 0;
+            if(dirty[c] == 0) {
+                memcpy(dst + (first + c) * msg_length, cw + c * length, msg_length);
+            } else {
+                res = decode(cw + c * length, dst + (first + c) * msg_length);
+            }
+
+            if(res != 0) n_failed++;
+            if(result != NULL) result[first + c] = res;
+        }
+    }
+
+    return n_failed;
+}
+
+} /* end of batch namespace */
+
+}
+
+#endif // RS_BATCH_HPP
@@ -0,0 +1,100 @@
+/* Common interface of the runtime and the compile-time specialized Reed-Solomon codecs
+ *
+ * See LICENSE */
+
+#ifndef RS_CODEC_HPP
+#define RS_CODEC_HPP
+#include <stdint.h>
+#include <stddef.h>
+#include "rs.hpp"
+#include "rs_fixed.hpp"
+
+namespace RS {
+
+/* Codecs are immutable after construction - one instance can be shared by any number of threads */
+class Codec {
+public:
+    virtual ~Codec() {}
+
+    virtual int MsgLength() const = 0;
+    virtual int EccLength() const = 0;
+
+    /* @brief Message encoding
+     * @param *src - input message buffer      (msg_length size)
+     * @param *dst - output buffer             (msg_length + ecc_length size at least) */
+    virtual void Encode(const void* src, void* dst) const = 0;
+
+    /* @brief Message decoding
+     * @param *src         - encoded message buffer   (msg_length + ecc_length size)
+     * @param *dst         - output buffer            (msg_length size at least)
+     * @param *erase_pos   - known errors positions
+     * @param erase_count  - count of known errors
+     * @return 0 if successfull, error code otherwise */
+    virtual int Decode(const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const = 0;
+
+    /* @brief Encoding of count messages
+     * @param *src   - input messages back to back   (count * msg_length size)
+     * @param *dst   - output codewords back to back (count * (msg_length + ecc_length) size at least)
+     * @param count  - number of messages */
+    virtual void EncodeBatch(const void* src, void* dst, size_t count) const = 0;
+
+    /* @brief Decoding of count codewords - syndromes of all of them at once, error correction only where needed
+     * @param *src         - encoded messages back to back (count * (msg_length + ecc_length) size)
+     * @param *dst         - output buffer                 (count * msg_length size at least)
+     * @param count        - number of codewords
+     * @param *result      - 0 or the error code of every codeword (count size, may be NULL)
+     * @param *erase_pos   - known errors positions, the same in every codeword
+     * @param erase_count  - count of known errors
+     * @return number of codewords that failed to decode */
+    virtual size_t DecodeBatch(const void* src, void* dst, size_t count, int* result = NULL,
+                               const uint8_t* erase_pos = NULL, size_t erase_count = 0) const = 0;
+};
+
+/* Any message and ECC length, chosen at runtime - scratch memory of every call is on the stack */
+class RuntimeCodec : public Codec {
+public:
+    RuntimeCodec(uint8_t msg_length, uint8_t ecc_length) : rs(msg_length, ecc_length) {}
+
+    int MsgLength() const override { return rs.msg_length; }
+    int EccLength() const override { return rs.ecc_length; }
+
+    void Encode(const void* src, void* dst) const override { rs.Encode(src, dst); }
+    int Decode(const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const override {
+        return rs.Decode(src, dst, erase_pos, erase_count);
+    }
+
+    void EncodeBatch(const void* src, void* dst, size_t count) const override { rs.EncodeBatch(src, dst, count); }
+    size_t DecodeBatch(const void* src, void* dst, size_t count, int* result = NULL,
+                       const uint8_t* erase_pos = NULL, size_t erase_count = 0) const override {
+        return rs.DecodeBatch(src, dst, count, result, erase_pos, erase_count);
+    }
+
+private:
+    ReedSolomon rs;
+};
+
+/* Message and ECC length fixed at compile time */
+template<int Msg, int Ecc>
+class FixedCodec : public Codec {
+public:
+    int MsgLength() const override { return Msg; }
+    int EccLength() const override { return Ecc; }
+
+    void Encode(const void* src, void* dst) const override { rs.Encode(src, dst); }
+    int Decode(const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const override {
+        return rs.Decode(src, dst, erase_pos, erase_count);
+    }
+
+    void EncodeBatch(const void* src, void* dst, size_t count) const override { rs.EncodeBatch(src, dst, count); }
+    size_t DecodeBatch(const void* src, void* dst, size_t count, int* result = NULL,
+                       const uint8_t* erase_pos = NULL, size_t erase_count = 0) const override {
+        return rs.DecodeBatch(src, dst, count, result, erase_pos, erase_count);
+    }
+
+private:
+    fixed::ReedSolomon<Msg, Ecc> rs;
+};
+
+}
+
+#endif // RS_CODEC_HPP
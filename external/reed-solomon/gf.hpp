@@ -9,6 +9,19 @@
 #include <string.h>
 #include "poly.hpp"
 
+/* with GCC / Clang on x86 the SIMD kernels are compiled in any case and picked at run time */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RS_GF_DISPATCH
+#define RS_GF_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RS_GF_TARGET(isa)
+#endif
+
+#if defined(RS_GF_DISPATCH) || defined(__SSSE3__) || defined(__AVX2__)
+#define RS_GF_SIMD
+#include <immintrin.h>
+#endif
+
 #if !defined DEBUG && !defined __CC_ARM
 #include <assert.h>
 #else
@@ -139,6 +152,135 @@ inline uint8_t inverse(uint8_t x){
     return exp[255 - log[x]]; /* == div(1, x); */
 }
 
+/* ##########################
+ * # OPERATIONS OVER REGIONS #
+ * ########################## */
+
+/* Products of every element with all values of the low and the high nibble of a byte:
+ * x * y == lo[x][y & 0xf] ^ hi[x][y >> 4]
+ * 16-entry rows fit in a single PSHUFB / VPSHUFB lookup */
+struct MulTables {
+    uint8_t lo[256][16];
+    uint8_t hi[256][16];
+
+    MulTables() {
+        for(int x = 0; x < 256; x++){
+            for(int i = 0; i < 16; i++){
+                lo[x][i] = mul(x, i);
+                hi[x][i] = mul(x, i << 4);
+            }
+        }
+    }
+};
+
+inline const MulTables& mul_tables() {
+    static const MulTables tables;
+    return tables;
+}
+
+#if defined(RS_GF_SIMD)
+/* @brief 32 bytes per step, returns the number of bytes processed */
+template<bool accumulate>
+RS_GF_TARGET("avx2")
+inline size_t mul_region_avx2(const uint8_t *lo, const uint8_t *hi, const uint8_t *src, uint8_t *dst, size_t n) {
+    const __m256i tlo  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) lo));
+    const __m256i thi  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) hi));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask)),
+                                     _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+        if(accumulate) p = _mm256_xor_si256(p, _mm256_loadu_si256((const __m256i*) (dst + i)));
+        _mm256_storeu_si256((__m256i*) (dst + i), p);
+    }
+    return i;
+}
+
+/* @brief 16 bytes per step, returns the number of bytes processed */
+template<bool accumulate>
+RS_GF_TARGET("ssse3")
+inline size_t mul_region_ssse3(const uint8_t *lo, const uint8_t *hi, const uint8_t *src, uint8_t *dst, size_t n) {
+    const __m128i tlo  = _mm_loadu_si128((const __m128i*) lo);
+    const __m128i thi  = _mm_loadu_si128((const __m128i*) hi);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i p = _mm_xor_si128(_mm_shuffle_epi8(tlo, _mm_and_si128(s, mask)),
+                                  _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+        if(accumulate) p = _mm_xor_si128(p, _mm_loadu_si128((const __m128i*) (dst + i)));
+        _mm_storeu_si128((__m128i*) (dst + i), p);
+    }
+    return i;
+}
+#endif
+
+enum SimdLevel { SIMD_NONE = 0, SIMD_SSSE3 = 1, SIMD_AVX2 = 2 };
+
+/* @brief Widest region kernel that the CPU supports */
+inline SimdLevel simd_level() {
+#if defined(__AVX2__)
+    return SIMD_AVX2;
+#elif defined(RS_GF_DISPATCH)
+    static const SimdLevel level = [](){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))  return SIMD_AVX2;
+        if(__builtin_cpu_supports("ssse3")) return SIMD_SSSE3;
+        return SIMD_NONE;
+    }();
+    return level;
+#elif defined(__SSSE3__)
+    return SIMD_SSSE3;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+/* @brief Product of a region with a scalar, optionally accumulated into the destination */
+template<bool accumulate>
+inline void mul_region_impl(uint8_t c, const uint8_t *src, uint8_t *dst, size_t n) {
+    const uint8_t *lo = mul_tables().lo[c];
+    const uint8_t *hi = mul_tables().hi[c];
+    size_t i = 0;
+
+#if defined(RS_GF_SIMD)
+    SimdLevel level = simd_level();
+
+    /* short regions (a typical ECC length) are faster with the 128-bit kernel */
+    if(level >= SIMD_AVX2 && n >= 64) {
+        i += mul_region_avx2<accumulate>(lo, hi, src, dst, n);
+    }
+    if(level >= SIMD_SSSE3) {
+        i += mul_region_ssse3<accumulate>(lo, hi, src + i, dst + i, n - i);
+    }
+#endif
+
+    for(; i < n; i++){
+        uint8_t p = lo[src[i] & 0x0f] ^ hi[src[i] >> 4];
+        dst[i] = accumulate ? (dst[i] ^ p) : p;
+    }
+}
+
+/* @brief Multiplication of a region by a scalar
+ * @param c   - scalar
+ * @param src - source region
+ * @param dst - destination region, dst[i] = c * src[i]
+ * @param n   - region length */
+inline void mul_region(uint8_t c, const uint8_t *src, uint8_t *dst, size_t n) {
+    mul_region_impl<false>(c, src, dst, n);
+}
+
+/* @brief Multiply-accumulate of a region by a scalar
+ * @param c   - scalar
+ * @param src - source region
+ * @param dst - destination region, dst[i] ^= c * src[i]
+ * @param n   - region length */
+inline void mul_add_region(uint8_t c, const uint8_t *src, uint8_t *dst, size_t n) {
+    if(c == 0) return;
+    mul_region_impl<true>(c, src, dst, n);
+}
+
 /* ##########################
  * # POLYNOMIALS OPERATIONS #
  * ########################## */
@@ -150,9 +292,7 @@ inline uint8_t inverse(uint8_t x){
 inline void
 poly_scale(const Poly *p, Poly *newp, uint16_t x) {
     newp->length = p->length;
-    for(uint16_t i = 0; i < p->length; i++){
-        newp->at(i) = mul(p->at(i), x);
-    }
+    mul_region(x, p->ptr(), newp->ptr(), p->length);
 }
 
 /* @brief Addition of two polynomials
@@ -225,9 +365,12 @@ poly_div(const Poly *p, const Poly *q, Poly *newp) {
  * @param x  - evaluation point */
 inline int8_t
 poly_eval(const Poly *p, uint16_t x) {
+    /* branchless Horner's scheme through the nibble tables of x */
+    const uint8_t *lo = mul_tables().lo[x];
+    const uint8_t *hi = mul_tables().hi[x];
     uint8_t y = p->at(0);
     for(uint8_t i = 1; i < p->length; i++){
-        y = mul(y, x) ^ p->at(i);
+        y = lo[y & 0x0f] ^ hi[y >> 4] ^ p->at(i);
     }
     return y;
 }
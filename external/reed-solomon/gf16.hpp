@@ -0,0 +1,121 @@
+/* Galois field GF(2^16) for the wide Reed-Solomon codec
+ *
+ * Log/antilog tables for the x^16 + x^12 + x^3 + x + 1 primitive polynomial, generated at compile time.
+ *
+ * See LICENSE */
+
+#ifndef GF16_HPP
+#define GF16_HPP
+#include <stdint.h>
+
+#if !defined DEBUG && !defined __CC_ARM
+#include <assert.h>
+#else
+#define assert(dummy)
+#endif
+
+namespace RS {
+
+namespace gf16 {
+
+constexpr uint32_t kPrimitive = 0x1100b;
+
+/* order of the multiplicative group - also the longest possible codeword */
+constexpr uint32_t kOrder = 65535;
+
+struct Tables {
+    /* exp is doubled so that the sum of two logs never needs a modulo */
+    uint16_t exp[2 * kOrder];
+    uint16_t log[kOrder + 1];
+
+    constexpr Tables() : exp(), log() {
+        uint32_t x = 1;
+        for(uint32_t i = 0; i < kOrder; i++){
+            exp[i] = (uint16_t) x;
+            exp[i + kOrder] = (uint16_t) x;
+            log[x] = (uint16_t) i;
+
+            x <<= 1;
+            if(x & 0x10000) x ^= kPrimitive;
+        }
+    }
+};
+
+/* class template - lets the tables be defined in this header */
+template<typename T = void>
+struct TableHolder {
+    static constexpr Tables tables{};
+};
+
+template<typename T>
+constexpr Tables TableHolder<T>::tables;
+
+inline const uint16_t* exp() { return TableHolder<>::tables.exp; }
+inline const uint16_t* log() { return TableHolder<>::tables.log; }
+
+/* @brief Multiplication in Galua Fields
+ * @param x - left operand
+ * @param y - right operand
+ * @return x * y */
+inline uint16_t mul(uint16_t x, uint16_t y) {
+    if(x == 0 || y == 0) return 0;
+    return exp()[log()[x] + log()[y]];
+}
+
+/* @brief Division in Galua Fields
+ * @param x - dividend
+ * @param y - divisor
+ * @return x / y */
+inline uint16_t div(uint16_t x, uint16_t y) {
+    assert(y != 0);
+    if(x == 0) return 0;
+    return exp()[log()[x] + kOrder - log()[y]];
+}
+
+/* @brief Inverse of a nonzero element
+ * @param x - number
+ * @return 1 / x */
+inline uint16_t inverse(uint16_t x) {
+    assert(x != 0);
+    return exp()[kOrder - log()[x]];
+}
+
+/* @brief Power of the generator element
+ * @param power - any exponent, negative ones included
+ * @return a^power */
+inline uint16_t alpha(int64_t power) {
+    int64_t e = power % (int64_t) kOrder;
+    if(e < 0) e += kOrder;
+    return exp()[e];
+}
+
+/* @brief Multiplication by a power of the generator element
+ * @param x     - number
+ * @param power - exponent in [0, kOrder)
+ * @return x * a^power */
+inline uint16_t mul_alpha(uint16_t x, uint32_t power) {
+    if(x == 0) return 0;
+    return exp()[log()[x] + power];
+}
+
+/* @brief Polynomial evaluation, lowest degree first
+ * @param *p - coefficients
+ * @param n  - number of coefficients
+ * @param x  - point
+ * @return p(x) */
+inline uint16_t poly_eval(const uint16_t *p, int n, uint16_t x) {
+    if(x == 0) return (n > 0) ? p[0] : 0;
+
+    uint32_t lx = log()[x];
+    uint16_t y = 0;
+    for(int i = n - 1; i >= 0; i--){
+        y = ((y == 0) ? 0 : exp()[log()[y] + lx]) ^ p[i];
+    }
+    return y;
+}
+
+} /* end of gf16 namespace */
+
+}
+
+#endif // GF16_HPP
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include "poly.hpp"
 #include "gf.hpp"
+#include "batch.hpp"
 
 #if !defined DEBUG && !defined __CC_ARM
 #include <assert.h>
@@ -19,82 +20,133 @@
 namespace RS {
 
 #define MSG_CNT 3   // message-length polynomials count
-#define POLY_CNT 14 // (ecc_length*2)-length polynomialc count
+#define POLY_CNT 14 // (ecc_length*2+1)-length polynomialc count
 
+/* The codec itself is immutable once constructed and can be shared between threads -
+ * all the scratch memory of an encode/decode call lives in a Workspace supplied by the caller.
+ * Calls without a workspace use a temporary one on the stack. */
 class ReedSolomon {
 public:
     const uint8_t msg_length;
     const uint8_t ecc_length;
 
     uint8_t * generator_cache = nullptr;
-    bool    generator_cached = false;
 
-    ReedSolomon(uint8_t msg_length_p, uint8_t ecc_length_p) :
-        msg_length(msg_length_p), ecc_length(ecc_length_p) {
-        generator_cache = new uint8_t[ecc_length + 1];
+    /* a^(k*(n-1-i)) for every codeword position i and syndrome k, ecc_length per row */
+    uint8_t * syndrome_cache = nullptr;
+
+    /* Scratch polynomials of one call - keep one per thread and reuse it across calls */
+    class Workspace {
+    public:
+        const uint8_t msg_length;
+        const uint8_t ecc_length;
+
+        /* @brief Workspace for the given codec
+         * @param *buffer - polynomials storage (rs.WorkspaceSize() bytes), allocated when NULL */
+        explicit Workspace(const ReedSolomon & rs, uint8_t* buffer = NULL) :
+            msg_length(rs.msg_length), ecc_length(rs.ecc_length),
+            memory(buffer), owns_memory(buffer == NULL) {
+            if(owns_memory) {
+                memory = new uint8_t[rs.WorkspaceSize()];
+            }
+
+            const uint8_t   enc_len  = msg_length + ecc_length;
+            const uint8_t   poly_len = ecc_length * 2 + 1;
+            uint8_t** memptr   = &memory;
+            uint16_t  offset   = 0;
+
+            /* Initialize first six polys manually cause their amount depends on template parameters */
+
+            polynoms[0].Init(ID_MSG_IN, offset, enc_len, memptr);
+            offset += enc_len;
 
-        const uint8_t   enc_len  = msg_length + ecc_length;
-        const uint8_t   poly_len = ecc_length * 2;
-        uint8_t** memptr   = &memory;
-        uint16_t  offset   = 0;
+            polynoms[1].Init(ID_MSG_OUT, offset, enc_len, memptr);
+            offset += enc_len;
 
-        /* Initialize first six polys manually cause their amount depends on template parameters */
+            for(uint8_t i = ID_GENERATOR; i < ID_MSG_E; i++) {
+                polynoms[i].Init(i, offset, poly_len, memptr);
+                offset += poly_len;
+            }
 
-        polynoms[0].Init(ID_MSG_IN, offset, enc_len, memptr);
-        offset += enc_len;
+            polynoms[5].Init(ID_MSG_E, offset, enc_len, memptr);
+            offset += enc_len;
 
-        polynoms[1].Init(ID_MSG_OUT, offset, enc_len, memptr);
-        offset += enc_len;
+            for(uint8_t i = ID_TPOLY3; i < ID_ERR_EVAL+2; i++) {
+                polynoms[i].Init(i, offset, poly_len, memptr);
+                offset += poly_len;
+            }
+        }
 
-        for(uint8_t i = ID_GENERATOR; i < ID_MSG_E; i++) {
-            polynoms[i].Init(i, offset, poly_len, memptr);
-            offset += poly_len;
+        ~Workspace() {
+            if(owns_memory) delete [] memory;
+            memory = NULL;
         }
 
-        polynoms[5].Init(ID_MSG_E, offset, enc_len, memptr);
-        offset += enc_len;
+        /* polynomials point into this object's own memory pointer */
+        Workspace(const Workspace &) = delete;
+        Workspace & operator=(const Workspace &) = delete;
+
+        uint8_t* memory;
+        bool     owns_memory;
+        Poly     polynoms[MSG_CNT + POLY_CNT];
+    };
+
+    ReedSolomon(uint8_t msg_length_p, uint8_t ecc_length_p) :
+        msg_length(msg_length_p), ecc_length(ecc_length_p) {
+        assert(msg_length + ecc_length < 256);
 
-        for(uint8_t i = ID_TPOLY3; i < ID_ERR_EVAL+2; i++) {
-            polynoms[i].Init(i, offset, poly_len, memptr);
-            offset += poly_len;
+        const int n = msg_length + ecc_length;
+        syndrome_cache = new uint8_t[n * ecc_length];
+        for(int i = 0; i < n; i++){
+            for(int k = 0; k < ecc_length; k++){
+                syndrome_cache[i * ecc_length + k] = gf::exp[(k * (n - 1 - i)) % 255];
+            }
         }
+
+        Workspace ws(*this);
+        GeneratorPoly(ws);
+
+        const Poly *gen = &ws.polynoms[ID_GENERATOR];
+        generator_cache = new uint8_t[ecc_length + 1];
+        memcpy(generator_cache, gen->ptr(), gen->length);
     }
 
     ~ReedSolomon() {
         delete [] generator_cache;
-        // Dummy destructor, gcc-generated one crashes programm
-        memory = NULL;
+        delete [] syndrome_cache;
+    }
+
+    ReedSolomon(const ReedSolomon &) = delete;
+    ReedSolomon & operator=(const ReedSolomon &) = delete;
+
+    /* @brief Size of the polynomials storage of a Workspace */
+    size_t WorkspaceSize() const {
+        return MSG_CNT * (msg_length + ecc_length) + POLY_CNT * (ecc_length * 2 + 1);
     }
 
+    /* @brief WorkspaceSize() of the longest codeword, msg_length + ecc_length == 255 */
+    static constexpr size_t kMaxWorkspaceSize = MSG_CNT * 255 + POLY_CNT * (255 * 2 + 1);
+
     /* @brief Message block encoding
+     * @param &ws  - scratch memory of the call (one per thread)
      * @param *src - input message buffer      (msg_lenth size)
      * @param *dst - output buffer for ecc     (ecc_length size at least) */
-     void EncodeBlock(const void* src, void* dst) {
-        assert(msg_length + ecc_length < 256);
-
-        /* Allocating memory on stack for polynomials storage */
-        uint8_t stack_memory[MSG_CNT * msg_length + POLY_CNT * ecc_length * 2];
-        this->memory = stack_memory;
+     void EncodeBlock(Workspace & ws, const void* src, void* dst) const {
+        assert(ws.msg_length == msg_length && ws.ecc_length == ecc_length);
 
         const uint8_t* src_ptr = (const uint8_t*) src;
         uint8_t* dst_ptr = (uint8_t*) dst;
 
-        Poly *msg_in  = &polynoms[ID_MSG_IN];
-        Poly *msg_out = &polynoms[ID_MSG_OUT];
-        Poly *gen     = &polynoms[ID_GENERATOR];
+        Poly *msg_in  = &ws.polynoms[ID_MSG_IN];
+        Poly *msg_out = &ws.polynoms[ID_MSG_OUT];
+        Poly *gen     = &ws.polynoms[ID_GENERATOR];
 
         // Weird shit, but without reseting msg_in it simply doesn't work
         msg_in->Reset();
         msg_out->Reset();
 
-        // Using cached generator or generating new one
-        if(generator_cached) {
-            gen->Set(generator_cache, ecc_length + 1);
-        } else {
-            GeneratorPoly();
-            memcpy(generator_cache, gen->ptr(), gen->length);
-            generator_cached = true;
-        }
+        // Generator is computed once in the constructor
+        gen->Set(generator_cache, ecc_length + 1);
 
         // Copying input message to internal polynomial
         msg_in->Set(src_ptr, msg_length);
@@ -102,42 +154,53 @@ public:
         msg_out->length = msg_in->length + ecc_length;
 
         // Here all the magic happens
-        uint8_t coef = 0; // cache
         for(uint8_t i = 0; i < msg_length; i++){
-            coef = msg_out->at(i);
-            if(coef != 0){
-                for(uint32_t j = 1; j < gen->length; j++){
-                    msg_out->at(i+j) ^= gf::mul(gen->at(j), coef);
-                }
-            }
+            gf::mul_add_region(msg_out->at(i), gen->ptr() + 1, msg_out->ptr() + i + 1, gen->length - 1);
         }
 
         // Copying ECC to the output buffer
         memcpy(dst_ptr, msg_out->ptr()+msg_length, ecc_length * sizeof(uint8_t));
     }
 
+    void EncodeBlock(const void* src, void* dst) const {
+        /* Allocating memory on stack for polynomials storage */
+        uint8_t stack_memory[kMaxWorkspaceSize];
+        Workspace ws(*this, stack_memory);
+
+        EncodeBlock(ws, src, dst);
+    }
+
     /* @brief Message encoding
+     * @param &ws  - scratch memory of the call (one per thread)
      * @param *src - input message buffer      (msg_lenth size)
      * @param *dst - output buffer             (msg_length + ecc_length size at least) */
-    void Encode(const void* src, void* dst) {
+    void Encode(Workspace & ws, const void* src, void* dst) const {
         uint8_t* dst_ptr = (uint8_t*) dst;
 
         // Copying message to the output buffer
         memcpy(dst_ptr, src, msg_length * sizeof(uint8_t));
 
         // Calling EncodeBlock to write ecc to out[ut buffer
+        EncodeBlock(ws, src, dst_ptr+msg_length);
+    }
+
+    void Encode(const void* src, void* dst) const {
+        uint8_t* dst_ptr = (uint8_t*) dst;
+
+        memcpy(dst_ptr, src, msg_length * sizeof(uint8_t));
         EncodeBlock(src, dst_ptr+msg_length);
     }
 
     /* @brief Message block decoding
+     * @param &ws          - scratch memory of the call (one per thread)
      * @param *src         - encoded message buffer   (msg_length size)
      * @param *ecc         - ecc buffer               (ecc_length size)
      * @param *msg_out     - output buffer            (msg_length size at least)
      * @param *erase_pos   - known errors positions
      * @param erase_count  - count of known errors
      * @return RESULT_SUCCESS if successfull, error code otherwise */
-     int DecodeBlock(const void* src, const void* ecc, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0) {
-        assert(msg_length + ecc_length < 256);
+     int DecodeBlock(Workspace & ws, const void* src, const void* ecc, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        assert(ws.msg_length == msg_length && ws.ecc_length == ecc_length);
 
         const uint8_t *src_ptr = (const uint8_t*) src;
         const uint8_t *ecc_ptr = (const uint8_t*) ecc;
@@ -148,18 +211,16 @@ public:
 
         bool ok;
 
-        /* Allocation memory on stack */
-        uint8_t stack_memory[MSG_CNT * msg_length + POLY_CNT * ecc_length * 2];
-        this->memory = stack_memory;
-
-        Poly *msg_in  = &polynoms[ID_MSG_IN];
-        Poly *msg_out = &polynoms[ID_MSG_OUT];
-        Poly *epos    = &polynoms[ID_ERASURES];
+        Poly *msg_in  = &ws.polynoms[ID_MSG_IN];
+        Poly *msg_out = &ws.polynoms[ID_MSG_OUT];
+        Poly *epos    = &ws.polynoms[ID_ERASURES];
 
         // Copying message to polynomials memory
         msg_in->Set(src_ptr, msg_length);
         msg_in->Set(ecc_ptr, ecc_length, msg_length);
-        msg_out->Copy(msg_in);
+
+        // Too many errors
+        if(erase_count > ecc_length) return 1;
 
         // Copying known errors to polynomial
         if(erase_pos == NULL) {
@@ -171,17 +232,19 @@ public:
             }
         }
 
+        // Erased symbols are zero in the output as well - the message may need no further correction
+        msg_out->Copy(msg_in);
+
         // Too many errors
         if(epos->length > ecc_length) return 1;
 
-        Poly *synd   = &polynoms[ID_SYNDROMES];
-        Poly *eloc   = &polynoms[ID_ERRORS_LOC];
-        Poly *reloc  = &polynoms[ID_TPOLY1];
-        Poly *err    = &polynoms[ID_ERRORS];
-        Poly *forney = &polynoms[ID_FORNEY];
+        Poly *synd   = &ws.polynoms[ID_SYNDROMES];
+        Poly *eloc   = &ws.polynoms[ID_ERRORS_LOC];
+        Poly *err    = &ws.polynoms[ID_ERRORS];
+        Poly *forney = &ws.polynoms[ID_FORNEY];
 
         // Calculating syndrome
-        CalcSyndromes(msg_in);
+        CalcSyndromes(ws, msg_in);
 
         // Checking for errors
         bool has_errors = false;
@@ -195,22 +258,16 @@ public:
         // Going to exit if no errors
         if(!has_errors) goto return_corrected_msg;
 
-        CalcForneySyndromes(synd, epos, src_len);
-        FindErrorLocator(forney, NULL, epos->length);
-
-        // Reversing syndrome
-        // TODO optimize through special Poly flag
-        reloc->length = eloc->length;
-        for(int8_t i = eloc->length-1, j = 0; i >= 0; i--, j++){
-            reloc->at(j) = eloc->at(i);
-        }
+        CalcForneySyndromes(ws, synd, epos, src_len);
+        ok = FindErrorLocator(ws, forney, epos->length);
+        if(!ok) return 1;
 
         // Fing errors
-        ok = FindErrors(reloc, src_len);
+        ok = FindErrors(ws, eloc, src_len);
         if(!ok) return 1;
 
-        // Error happened while finding errors (so helpfull :D)
-        if(err->length == 0) return 1;
+        // Error happened while finding errors (so helpfull :D) - fine when all errata are known erasures
+        if(err->length == 0 && epos->length == 0) return 1;
 
         /* Adding found errors with known */
         for(uint8_t i = 0; i < err->length; i++) {
@@ -218,7 +275,8 @@ public:
         }
 
         // Correcting errors
-        CorrectErrata(synd, epos, msg_in);
+        ok = CorrectErrata(ws, synd, epos, msg_in);
+        if(!ok) return 1;
 
     return_corrected_msg:
         // Wrighting corrected message to output buffer
@@ -227,19 +285,82 @@ public:
         return 0;
     }
 
+    int DecodeBlock(const void* src, const void* ecc, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        /* Allocation memory on stack */
+        uint8_t stack_memory[kMaxWorkspaceSize];
+        Workspace ws(*this, stack_memory);
+
+        return DecodeBlock(ws, src, ecc, dst, erase_pos, erase_count);
+    }
+
     /* @brief Message block decoding
+     * @param &ws          - scratch memory of the call (one per thread)
      * @param *src         - encoded message buffer   (msg_length + ecc_length size)
      * @param *msg_out     - output buffer            (msg_length size at least)
      * @param *erase_pos   - known errors positions
      * @param erase_count  - count of known errors
      * @return RESULT_SUCCESS if successfull, error code otherwise */
-     int Decode(const void* src, void* dst, uint8_t* erase_pos = NULL, size_t erase_count = 0) {
+     int Decode(Workspace & ws, const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+         const uint8_t *src_ptr = (const uint8_t*) src;
+         const uint8_t *ecc_ptr = src_ptr + msg_length;
+
+         return DecodeBlock(ws, src, ecc_ptr, dst, erase_pos, erase_count);
+     }
+
+     int Decode(const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
          const uint8_t *src_ptr = (const uint8_t*) src;
          const uint8_t *ecc_ptr = src_ptr + msg_length;
 
          return DecodeBlock(src, ecc_ptr, dst, erase_pos, erase_count);
      }
 
+    /* @brief Encoding of count messages of the same shape
+     * @param *src   - input messages back to back   (count * msg_length size)
+     * @param *dst   - output codewords back to back (count * (msg_length + ecc_length) size at least)
+     * @param count  - number of messages */
+    void EncodeBatch(const void* src, void* dst, size_t count) const {
+        batch::Encode(generator_cache, msg_length, ecc_length, (const uint8_t*) src, (uint8_t*) dst, count);
+    }
+
+    /* @brief Decoding of count codewords of the same shape - only the ones with non-zero syndromes
+     *        go through DecodeBlock, every one of them when there are erasures
+     * @param &ws          - scratch memory of the call (one per thread)
+     * @param *src         - encoded messages back to back (count * (msg_length + ecc_length) size)
+     * @param *dst         - output buffer                 (count * msg_length size at least)
+     * @param count        - number of codewords
+     * @param *result      - 0 or the error code of every codeword (count size, may be NULL)
+     * @param *erase_pos   - known errors positions, the same in every codeword
+     * @param erase_count  - count of known errors
+     * @return number of codewords that failed to decode */
+    size_t DecodeBatch(Workspace & ws, const void* src, void* dst, size_t count, int* result = NULL,
+                       const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        const uint8_t *src_ptr = (const uint8_t*) src;
+        uint8_t *dst_ptr = (uint8_t*) dst;
+        const int length = msg_length + ecc_length;
+
+        auto decode = [&](const uint8_t *cw, uint8_t *msg) {
+            return DecodeBlock(ws, cw, cw + msg_length, msg, erase_pos, erase_count);
+        };
+
+        if(erase_count == 0) {
+            return batch::Decode(syndrome_cache, msg_length, ecc_length, src_ptr, dst_ptr, count, result, decode);
+        }
+
+        size_t n_failed = 0;
+        for(size_t i = 0; i < count; i++){
+            int res = decode(src_ptr + i * length, dst_ptr + i * msg_length);
+            if(res != 0) n_failed++;
+            if(result != NULL) result[i] = res;
+        }
+        return n_failed;
+    }
+
+    size_t DecodeBatch(const void* src, void* dst, size_t count, int* result = NULL,
+                       const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        Workspace ws(*this);
+        return DecodeBatch(ws, src, dst, count, result, erase_pos, erase_count);
+    }
+
 #ifndef DEBUG
 private:
 #endif
@@ -269,17 +390,13 @@ private:
         ID_ERR_EVAL
     };
 
-    // Pointer for polynomials memory on stack
-    uint8_t* memory;
-    Poly polynoms[MSG_CNT + POLY_CNT];
-
-    void GeneratorPoly() {
-        Poly *gen = polynoms + ID_GENERATOR;
+    void GeneratorPoly(Workspace & ws) const {
+        Poly *gen = ws.polynoms + ID_GENERATOR;
         gen->at(0) = 1;
         gen->length = 1;
 
-        Poly *mulp = polynoms + ID_TPOLY1;
-        Poly *temp = polynoms + ID_TPOLY2;
+        Poly *mulp = ws.polynoms + ID_TPOLY1;
+        Poly *temp = ws.polynoms + ID_TPOLY2;
         mulp->length = 2;
 
         for(int8_t i = 0; i < ecc_length; i++){
@@ -292,67 +409,80 @@ private:
         }
     }
 
-    void CalcSyndromes(const Poly *msg) {
-        Poly *synd = &polynoms[ID_SYNDROMES];
+    void CalcSyndromes(Workspace & ws, const Poly *msg) const {
+        Poly *synd = &ws.polynoms[ID_SYNDROMES];
         synd->length = ecc_length+1;
-        synd->at(0) = 0;
+        memset(synd->ptr(), 0, synd->length);
+
+        /* all syndromes at once - one multiply-accumulate of a row of powers per codeword byte */
+        if(msg->length == msg_length + ecc_length) {
+            for(uint8_t i = 0; i < msg->length; i++){
+                gf::mul_add_region(msg->at(i), syndrome_cache + i * ecc_length, synd->ptr() + 1, ecc_length);
+            }
+            return;
+        }
+
         for(uint8_t i = 1; i < ecc_length+1; i++){
             synd->at(i) = gf::poly_eval(msg, gf::pow(2, i-1));
         }
     }
 
-    void FindErrataLocator(const Poly *epos) {
-        Poly *errata_loc = &polynoms[ID_ERASURES_LOC];
-        Poly *mulp = &polynoms[ID_TPOLY1];
-        Poly *addp = &polynoms[ID_TPOLY2];
-        Poly *apol = &polynoms[ID_TPOLY3];
-        Poly *temp = &polynoms[ID_TPOLY4];
+    /* errata locator prod(1 + a^c x) over the coefficient positions c, highest degree first -
+     * every factor is multiplied in place */
+    void FindErrataLocator(Workspace & ws, const Poly *epos) const {
+        Poly *errata_loc = &ws.polynoms[ID_ERASURES_LOC];
 
         errata_loc->length = 1;
         errata_loc->at(0)  = 1;
 
-        mulp->length = 1;
-        addp->length = 2;
-
+        uint8_t *p = errata_loc->ptr();
         for(uint8_t i = 0; i < epos->length; i++){
-            mulp->at(0) = 1;
-            addp->at(0) = gf::pow(2, epos->at(i));
-            addp->at(1) = 0;
+            const uint8_t x   = gf::exp[epos->at(i)];
+            const uint8_t len = errata_loc->length;
 
-            gf::poly_add(mulp, addp, apol);
-            gf::poly_mul(errata_loc, apol, temp);
+            p[len] = p[len-1];
+            for(uint8_t k = len-1; k > 0; k--){
+                p[k] = gf::mul(p[k], x) ^ p[k-1];
+            }
+            p[0] = gf::mul(p[0], x);
 
-            errata_loc->Copy(temp);
+            errata_loc->length = len+1;
         }
     }
 
-    void FindErrorEvaluator(const Poly *synd, const Poly *errata_loc, Poly *dst, uint8_t ecclen) {
-        Poly *mulp = &polynoms[ID_TPOLY1];
-        gf::poly_mul(synd, errata_loc, mulp);
-
-        Poly *divisor = &polynoms[ID_TPOLY2];
-        divisor->length = ecclen+2;
-
-        divisor->Reset();
-        divisor->at(0) = 1;
-
-        gf::poly_div(mulp, divisor, dst);
+    /* synd * errata_loc mod x^(ecclen+1) - only the low order coefficients of the product are computed */
+    void FindErrorEvaluator(const Poly *synd, const Poly *errata_loc, Poly *dst, uint8_t ecclen) const {
+        const int plen  = synd->length + errata_loc->length - 1;
+        const int rlen  = ecclen + 1;
+        const int start = plen - rlen;
+
+        dst->length = rlen;
+        for(int k = 0; k < rlen; k++){
+            const int idx = start + k;
+            const int j0  = (idx > synd->length - 1) ? idx - (synd->length - 1) : 0;
+            const int j1  = (idx < errata_loc->length - 1) ? idx : errata_loc->length - 1;
+
+            uint8_t acc = 0;
+            for(int j = j0; j <= j1; j++){
+                acc ^= gf::mul(synd->at(idx - j), errata_loc->at(j));
+            }
+            dst->at(k) = acc;
+        }
     }
 
-    void CorrectErrata(const Poly *synd, const Poly *err_pos, const Poly *msg_in) {
-        Poly *c_pos     = &polynoms[ID_COEF_POS];
-        Poly *corrected = &polynoms[ID_MSG_OUT];
+    bool CorrectErrata(Workspace & ws, const Poly *synd, const Poly *err_pos, const Poly *msg_in) const {
+        Poly *c_pos     = &ws.polynoms[ID_COEF_POS];
+        Poly *corrected = &ws.polynoms[ID_MSG_OUT];
         c_pos->length = err_pos->length;
 
         for(uint8_t i = 0; i < err_pos->length; i++)
             c_pos->at(i) = msg_in->length - 1 - err_pos->at(i);
 
-        /* uses t_poly 1, 2, 3, 4 */
-        FindErrataLocator(c_pos);
-        Poly *errata_loc = &polynoms[ID_ERASURES_LOC];
+        FindErrataLocator(ws, c_pos);
+        Poly *errata_loc = &ws.polynoms[ID_ERASURES_LOC];
 
         /* reversing syndromes */
-        Poly *rsynd = &polynoms[ID_TPOLY3];
+        Poly *rsynd = &ws.polynoms[ID_TPOLY3];
         rsynd->length = synd->length;
 
         for(int8_t i = synd->length-1, j = 0; i >= 0; i--, j++) {
@@ -360,139 +490,123 @@ private:
         }
 
         /* getting reversed error evaluator polynomial */
-        Poly *re_eval = &polynoms[ID_TPOLY4];
-
-        /* uses T_POLY 1, 2 */
+        Poly *re_eval = &ws.polynoms[ID_TPOLY4];
         FindErrorEvaluator(rsynd, errata_loc, re_eval, errata_loc->length-1);
 
-        /* reversing it back */
-        Poly *e_eval = &polynoms[ID_ERR_EVAL];
-        e_eval->length = re_eval->length;
-        for(int8_t i = re_eval->length-1, j = 0; i >= 0; i--, j++) {
-            e_eval->at(j) = re_eval->at(i);
-        }
-
-        Poly *X = &polynoms[ID_TPOLY1]; /* this will store errors positions */
-        X->length = 0;
+        /* errata locators X_i = a^c straight from the table, their inverses a^(255-c) */
+        Poly *X     = &ws.polynoms[ID_TPOLY1];
+        Poly *X_inv = &ws.polynoms[ID_TPOLY2];
+        X->length     = c_pos->length;
+        X_inv->length = c_pos->length;
 
-        int16_t l;
         for(uint8_t i = 0; i < c_pos->length; i++){
-            l = 255 - c_pos->at(i);
-            X->Append(gf::pow(2, -l));
+            X->at(i)     = gf::exp[c_pos->at(i)];
+            X_inv->at(i) = gf::exp[255 - c_pos->at(i)];
         }
 
         /* Magnitude polynomial
            Shit just got real */
-        Poly *E = &polynoms[ID_MSG_E];
+        Poly *E = &ws.polynoms[ID_MSG_E];
         E->Reset();
         E->length = msg_in->length;
 
-        uint8_t Xi_inv;
-
-        Poly *err_loc_prime_temp = &polynoms[ID_TPOLY2];
-
-        uint8_t err_loc_prime;
-        uint8_t y;
-
         for(uint8_t i = 0; i < X->length; i++){
-            Xi_inv = gf::inverse(X->at(i));
+            const uint8_t Xi_inv = X_inv->at(i);
 
-            err_loc_prime_temp->length = 0;
+            uint8_t err_loc_prime = 1;
             for(uint8_t j = 0; j < X->length; j++){
                 if(j != i){
-                    err_loc_prime_temp->Append(gf::sub(1, gf::mul(Xi_inv, X->at(j))));
+                    err_loc_prime = gf::mul(err_loc_prime, 1 ^ gf::mul(Xi_inv, X->at(j)));
                 }
             }
 
-            err_loc_prime = 1;
-            for(uint8_t j = 0; j < err_loc_prime_temp->length; j++){
-                err_loc_prime = gf::mul(err_loc_prime, err_loc_prime_temp->at(j));
-            }
+            /* repeated errata position - more errors than the code can locate */
+            if(err_loc_prime == 0) return false;
 
-            y = gf::poly_eval(re_eval, Xi_inv);
-            y = gf::mul(gf::pow(X->at(i), 1), y);
+            uint8_t y = gf::poly_eval(re_eval, Xi_inv);
+            y = gf::mul(X->at(i), y);
 
             E->at(err_pos->at(i)) = gf::div(y, err_loc_prime);
         }
 
         gf::poly_add(msg_in, E, corrected);
+        return true;
     }
 
-    bool FindErrorLocator(const Poly *synd, Poly *erase_loc = NULL, size_t erase_count = 0) {
-        Poly *error_loc = &polynoms[ID_ERRORS_LOC];
-        Poly *err_loc   = &polynoms[ID_TPOLY1];
-        Poly *old_loc   = &polynoms[ID_TPOLY2];
-        Poly *temp      = &polynoms[ID_TPOLY3];
-        Poly *temp2     = &polynoms[ID_TPOLY4];
-
-        if(erase_loc != NULL) {
-            err_loc->Copy(erase_loc);
-            old_loc->Copy(erase_loc);
-        } else {
-            err_loc->length = 1;
-            old_loc->length = 1;
-            err_loc->at(0)  = 1;
-            old_loc->at(0)  = 1;
-        }
-
-        uint8_t synd_shift = 0;
-        if(synd->length > ecc_length) {
-            synd_shift = synd->length - ecc_length;
-        }
-
-        uint8_t K = 0;
-        uint8_t delta = 0;
-        uint8_t index;
-
-        for(uint8_t i = 0; i < ecc_length - erase_count; i++){
-            if(erase_loc != NULL)
-                K = erase_count + i + synd_shift;
-            else
-                K = i + synd_shift;
-
-            delta = synd->at(K);
-            for(uint8_t j = 1; j < err_loc->length; j++) {
-                index = err_loc->length - j - 1;
-                delta ^= gf::mul(err_loc->at(index), synd->at(K-j));
+    /* Berlekamp-Massey over the first ecc_length - erase_count Forney syndromes, in place.
+     * The locator sigma ends up in ERRORS_LOC lowest degree first, with exactly L + 1 coefficients */
+    bool FindErrorLocator(Workspace & ws, const Poly *synd, size_t erase_count) const {
+        Poly *error_loc = &ws.polynoms[ID_ERRORS_LOC];
+
+        const int len = ecc_length + 1;
+        uint8_t *sigma = ws.polynoms[ID_TPOLY1].ptr();
+        uint8_t *prev  = ws.polynoms[ID_TPOLY2].ptr();
+        uint8_t *temp  = ws.polynoms[ID_TPOLY3].ptr();
+
+        memset(sigma, 0, len);
+        memset(prev, 0, len);
+        sigma[0] = 1;
+        prev[0]  = 1;
+
+        int L = 0;
+        int m = 1;
+        uint8_t b = 1;
+        const int n_synd = ecc_length - (int) erase_count;
+        for(int r = 0; r < n_synd; r++){
+            uint8_t delta = synd->at(r);
+            for(int i = 1; i <= L; i++){
+                delta ^= gf::mul(sigma[i], synd->at(r - i));
             }
 
-            old_loc->Append(0);
+            if(delta == 0) {
+                m++;
+                continue;
+            }
 
-            if(delta != 0) {
-                if(old_loc->length > err_loc->length) {
-                    gf::poly_scale(old_loc, temp, delta);
-                    gf::poly_scale(err_loc, old_loc, gf::inverse(delta));
-                    err_loc->Copy(temp);
-                }
-                gf::poly_scale(old_loc, temp, delta);
-                gf::poly_add(err_loc, temp, temp2);
-                err_loc->Copy(temp2);
+            /* sigma += delta/b x^m prev - the old sigma becomes prev when the length grows */
+            const bool grow = (2*L <= r);
+            if(grow) memcpy(temp, sigma, len);
+            gf::mul_add_region(gf::div(delta, b), prev, sigma + m, len - m);
+            if(grow) {
+                uint8_t *t = prev;
+                prev = temp;
+                temp = t;
+
+                L = r + 1 - L;
+                b = delta;
+                m = 1;
+            } else {
+                m++;
             }
         }
 
-        uint32_t shift = 0;
-        while(err_loc->length && err_loc->at(shift) == 0) shift++;
-
-        uint32_t errs = err_loc->length - shift - 1;
-        if(((errs - erase_count) * 2 + erase_count) > ecc_length){
-            return false; /* Error count is greater then we can fix! */
-        }
+        /* Error count is greater then we can fix! */
+        if(2*L + (int) erase_count > ecc_length || sigma[L] == 0) return false;
 
-        memcpy(error_loc->ptr(), err_loc->ptr() + shift, (err_loc->length - shift) * sizeof(uint8_t));
-        error_loc->length = (err_loc->length - shift);
+        error_loc->Set(sigma, L + 1);
         return true;
     }
 
-    bool FindErrors(const Poly *error_loc, size_t msg_in_size) {
-        Poly *err = &polynoms[ID_ERRORS];
+    /* Chien search - the roots of sigma(x) are a^-i for the errors at positions n-1-i.
+     * Term j of sigma(a^-i) is kept between the steps and multiplied by a^-j, a table lookup each */
+    bool FindErrors(Workspace & ws, const Poly *error_loc, size_t msg_in_size) const {
+        Poly *err = &ws.polynoms[ID_ERRORS];
+        uint8_t *term = ws.polynoms[ID_TPOLY2].ptr();
 
-        uint8_t errs = error_loc->length - 1;
+        const uint8_t errs = error_loc->length - 1;
         err->length = 0;
 
-        for(uint8_t i = 0; i < msg_in_size; i++) {
-            if(gf::poly_eval(error_loc, gf::pow(2, i)) == 0) {
+        memcpy(term, error_loc->ptr(), error_loc->length);
+        for(uint8_t i = 0; i < msg_in_size && err->length < errs; i++) {
+            uint8_t sum = 0;
+            for(uint8_t j = 0; j <= errs; j++) sum ^= term[j];
+            if(sum == 0) {
                 err->Append(msg_in_size - 1 - i);
             }
+
+            for(uint8_t j = 1; j <= errs; j++) {
+                if(term[j] != 0) term[j] = gf::exp[gf::log[term[j]] + 255 - j];
+            }
         }
 
         /* Sanity check:
@@ -504,21 +618,15 @@ private:
         return true;
     }
 
-    void CalcForneySyndromes(const Poly *synd, const Poly *erasures_pos, size_t msg_in_size) {
-        Poly *erase_pos_reversed = &polynoms[ID_TPOLY1];
-        Poly *forney_synd = &polynoms[ID_FORNEY];
-        erase_pos_reversed->length = 0;
-
-        for(uint8_t i = 0; i < erasures_pos->length; i++){
-            erase_pos_reversed->Append(msg_in_size - 1 - erasures_pos->at(i));
-        }
+    void CalcForneySyndromes(Workspace & ws, const Poly *synd, const Poly *erasures_pos, size_t msg_in_size) const {
+        Poly *forney_synd = &ws.polynoms[ID_FORNEY];
 
         forney_synd->Reset();
         forney_synd->Set(synd->ptr()+1, synd->length-1);
 
         uint8_t x;
         for(uint8_t i = 0; i < erasures_pos->length; i++) {
-            x = gf::pow(2, erase_pos_reversed->at(i));
+            x = gf::exp[msg_in_size - 1 - erasures_pos->at(i)];
             for(int8_t j = 0; j < forney_synd->length - 1; j++){
                 forney_synd->at(j) = gf::mul(forney_synd->at(j), x) ^ forney_synd->at(j+1);
             }
@@ -0,0 +1,279 @@
+/* Reed-Solomon codec over GF(2^16) for codewords of thousands of symbols
+ *
+ * Symbols are uint16_t, msg_length + ecc_length may be up to 65535. Generator roots a^0 .. a^(ecc_length-1),
+ * first symbol of the codeword is the highest degree coefficient - the same layout as RS::ReedSolomon.
+ *
+ * See LICENSE */
+
+#ifndef RS16_HPP
+#define RS16_HPP
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "gf16.hpp"
+
+namespace RS {
+
+/* Immutable once constructed, like RS::ReedSolomon - decoding scratch memory lives in a caller supplied Workspace */
+class ReedSolomon16 {
+public:
+    const int msg_length;
+    const int ecc_length;
+    const int length;
+
+    /* Scratch memory of one decode call - keep one per thread and reuse it across calls */
+    class Workspace {
+    public:
+        explicit Workspace(const ReedSolomon16 & rs) :
+            codeword(rs.length), synd(rs.ecc_length), fsynd(rs.ecc_length), omega(rs.ecc_length),
+            gamma(rs.ecc_length + 1), sigma(rs.ecc_length + 1), prev(rs.ecc_length + 1), temp(rs.ecc_length + 1),
+            lambda(rs.ecc_length + 1), lambda_prime(rs.ecc_length + 1) {}
+
+        std::vector<uint16_t> codeword;
+        std::vector<uint16_t> synd;
+        std::vector<uint16_t> fsynd;
+        std::vector<uint16_t> omega;
+        std::vector<uint16_t> gamma;
+        std::vector<uint16_t> sigma;
+        std::vector<uint16_t> prev;
+        std::vector<uint16_t> temp;
+        std::vector<uint16_t> lambda;
+        std::vector<uint16_t> lambda_prime;
+    };
+
+    ReedSolomon16(int msg_length_p, int ecc_length_p) :
+        msg_length(msg_length_p), ecc_length(ecc_length_p), length(msg_length_p + ecc_length_p) {
+        assert(msg_length > 0 && ecc_length > 0 && length <= (int) gf16::kOrder);
+
+        /* g(x) = (x + a^0)(x + a^1)...(x + a^(ecc_length-1)), highest degree first */
+        std::vector<uint16_t> gen(ecc_length + 1, 0);
+        gen[0] = 1;
+        for(int i = 0; i < ecc_length; i++){
+            for(int j = i + 1; j > 0; j--){
+                gen[j] ^= gf16::mul_alpha(gen[j - 1], i);
+            }
+        }
+
+        /* logs of the coefficients below the leading one - the encoder multiplies through the tables */
+        generator_log.resize(ecc_length);
+        for(int j = 0; j < ecc_length; j++){
+            generator_log[j] = (gen[j + 1] == 0) ? kZeroLog : gf16::log()[gen[j + 1]];
+        }
+    }
+
+    /* @brief Message block encoding
+     * @param *src - input message buffer      (msg_length symbols)
+     * @param *dst - output buffer for ecc     (ecc_length symbols at least) */
+    void EncodeBlock(const uint16_t* src, uint16_t* dst) const {
+        const uint16_t *exp = gf16::exp();
+        const uint16_t *log = gf16::log();
+
+        /* remainder of the division by the generator, shifted one symbol per message symbol */
+        memset(dst, 0, ecc_length * sizeof(uint16_t));
+        for(int i = 0; i < msg_length; i++){
+            uint16_t coef = src[i] ^ dst[0];
+            memmove(dst, dst + 1, (ecc_length - 1) * sizeof(uint16_t));
+            dst[ecc_length - 1] = 0;
+            if(coef == 0) continue;
+
+            uint32_t lc = log[coef];
+            for(int j = 0; j < ecc_length; j++){
+                if(generator_log[j] != kZeroLog) dst[j] ^= exp[lc + generator_log[j]];
+            }
+        }
+    }
+
+    /* @brief Message encoding
+     * @param *src - input message buffer      (msg_length symbols)
+     * @param *dst - output buffer             (msg_length + ecc_length symbols at least) */
+    void Encode(const uint16_t* src, uint16_t* dst) const {
+        memcpy(dst, src, msg_length * sizeof(uint16_t));
+        EncodeBlock(src, dst + msg_length);
+    }
+
+    /* @brief Message block decoding
+     * @param &ws          - scratch memory of the call (one per thread)
+     * @param *src         - encoded message buffer   (msg_length symbols)
+     * @param *ecc         - ecc buffer               (ecc_length symbols)
+     * @param *dst         - output buffer            (msg_length symbols at least)
+     * @param *erase_pos   - known errors positions
+     * @param erase_count  - count of known errors
+     * @return 0 if successfull, error code otherwise */
+    int DecodeBlock(Workspace & ws, const uint16_t* src, const uint16_t* ecc, uint16_t* dst,
+                    const uint16_t* erase_pos = NULL, size_t erase_count = 0) const {
+        uint16_t *cw = ws.codeword.data();
+        memcpy(cw, src, msg_length * sizeof(uint16_t));
+        memcpy(cw + msg_length, ecc, ecc_length * sizeof(uint16_t));
+
+        if(erase_count > (size_t) ecc_length) return 1;
+        for(size_t i = 0; i < erase_count; i++){
+            if(erase_pos[i] >= length) return 1;
+            cw[erase_pos[i]] = 0;
+        }
+
+        /* syndromes, lowest degree first - Horner's scheme at every root */
+        bool has_errors = false;
+        for(int k = 0; k < ecc_length; k++){
+            uint16_t s = 0;
+            for(int i = 0; i < length; i++){
+                s = gf16::mul_alpha(s, k) ^ cw[i];
+            }
+            ws.synd[k] = s;
+            has_errors |= (s != 0);
+        }
+
+        if(has_errors) {
+            if(!Correct(ws, erase_pos, (int) erase_count)) return 1;
+        }
+
+        memcpy(dst, cw, msg_length * sizeof(uint16_t));
+        return 0;
+    }
+
+    /* @brief Message decoding
+     * @param &ws          - scratch memory of the call (one per thread)
+     * @param *src         - encoded message buffer   (msg_length + ecc_length symbols)
+     * @param *dst         - output buffer            (msg_length symbols at least)
+     * @param *erase_pos   - known errors positions
+     * @param erase_count  - count of known errors
+     * @return 0 if successfull, error code otherwise */
+    int Decode(Workspace & ws, const uint16_t* src, uint16_t* dst, const uint16_t* erase_pos = NULL, size_t erase_count = 0) const {
+        return DecodeBlock(ws, src, src + msg_length, dst, erase_pos, erase_count);
+    }
+
+    int Decode(const uint16_t* src, uint16_t* dst, const uint16_t* erase_pos = NULL, size_t erase_count = 0) const {
+        Workspace ws(*this);
+        return Decode(ws, src, dst, erase_pos, erase_count);
+    }
+
+private:
+    /* marks a zero generator coefficient - it has no logarithm */
+    static constexpr uint32_t kZeroLog = 0xffffffff;
+
+    std::vector<uint32_t> generator_log;
+
+    /* a^(N-1-i) - locator of codeword symbol i */
+    uint16_t Locator(int i) const {
+        return gf16::alpha(length - 1 - i);
+    }
+
+    /* Errors-and-erasures decoding: Forney syndromes, Berlekamp-Massey, Chien search, Forney algorithm */
+    bool Correct(Workspace & ws, const uint16_t *erase_pos, int erase_count) const {
+        const int ecc = ecc_length;
+        uint16_t *cw = ws.codeword.data();
+        const uint16_t *synd = ws.synd.data();
+
+        /* erasure locator Gamma(x) = prod(1 + X_j x) */
+        uint16_t *gamma = ws.gamma.data();
+        memset(gamma, 0, (ecc + 1) * sizeof(uint16_t));
+        gamma[0] = 1;
+        for(int j = 0; j < erase_count; j++){
+            uint16_t x = Locator(erase_pos[j]);
+            for(int i = j + 1; i > 0; i--){
+                gamma[i] ^= gf16::mul(gamma[i - 1], x);
+            }
+        }
+
+        /* Forney syndromes Gamma(x)S(x) mod x^ecc - the errors are located with the last ecc - erase_count of them */
+        uint16_t *fsynd = ws.fsynd.data();
+        memset(fsynd, 0, ecc * sizeof(uint16_t));
+        for(int i = 0; i <= erase_count; i++){
+            if(gamma[i] == 0) continue;
+            for(int k = 0; k + i < ecc; k++){
+                fsynd[k + i] ^= gf16::mul(gamma[i], synd[k]);
+            }
+        }
+
+        /* Berlekamp-Massey for the error locator sigma(x) */
+        uint16_t *sigma = ws.sigma.data();
+        uint16_t *prev = ws.prev.data();
+        uint16_t *temp = ws.temp.data();
+        memset(sigma, 0, (ecc + 1) * sizeof(uint16_t));
+        memset(prev, 0, (ecc + 1) * sizeof(uint16_t));
+        sigma[0] = 1;
+        prev[0] = 1;
+
+        int L = 0;
+        int m = 1;
+        uint16_t b = 1;
+        const int n_synd = ecc - erase_count;
+        const uint16_t *s = fsynd + erase_count;
+        for(int r = 0; r < n_synd; r++){
+            uint16_t delta = s[r];
+            for(int i = 1; i <= L; i++){
+                delta ^= gf16::mul(sigma[i], s[r - i]);
+            }
+
+            if(delta == 0) {
+                m++;
+                continue;
+            }
+
+            uint16_t coef = gf16::div(delta, b);
+            bool grow = (2*L <= r);
+            if(grow) memcpy(temp, sigma, (ecc + 1) * sizeof(uint16_t));
+            for(int i = 0; i + m <= ecc; i++){
+                sigma[i + m] ^= gf16::mul(coef, prev[i]);
+            }
+            if(grow) {
+                L = r + 1 - L;
+                memcpy(prev, temp, (ecc + 1) * sizeof(uint16_t));
+                b = delta;
+                m = 1;
+            } else {
+                m++;
+            }
+        }
+
+        if(2*L + erase_count > ecc) return false;
+
+        /* errata locator Lambda(x) = sigma(x)Gamma(x) */
+        uint16_t *lambda = ws.lambda.data();
+        memset(lambda, 0, (ecc + 1) * sizeof(uint16_t));
+        const int n_errata = L + erase_count;
+        for(int i = 0; i <= L; i++){
+            for(int j = 0; j <= erase_count; j++){
+                lambda[i + j] ^= gf16::mul(sigma[i], gamma[j]);
+            }
+        }
+
+        /* error evaluator Omega(x) = S(x)Lambda(x) mod x^ecc */
+        uint16_t *omega = ws.omega.data();
+        memset(omega, 0, ecc * sizeof(uint16_t));
+        for(int i = 0; i <= n_errata && i < ecc; i++){
+            if(lambda[i] == 0) continue;
+            for(int k = 0; k + i < ecc; k++){
+                omega[k + i] ^= gf16::mul(lambda[i], synd[k]);
+            }
+        }
+
+        /* formal derivative - only the odd powers survive in characteristic 2 */
+        uint16_t *lambda_prime = ws.lambda_prime.data();
+        memset(lambda_prime, 0, (ecc + 1) * sizeof(uint16_t));
+        for(int i = 1; i <= n_errata; i += 2){
+            lambda_prime[i - 1] = lambda[i];
+        }
+
+        /* Chien search over the positions of the (shortened) codeword */
+        int n_found = 0;
+        for(int i = 0; i < length; i++){
+            uint16_t x = Locator(i);
+            uint16_t x_inv = gf16::inverse(x);
+            if(gf16::poly_eval(lambda, n_errata + 1, x_inv) != 0) continue;
+
+            uint16_t denom = gf16::poly_eval(lambda_prime, n_errata, x_inv);
+            if(denom == 0) return false;
+
+            cw[i] ^= gf16::mul(x, gf16::div(gf16::poly_eval(omega, ecc, x_inv), denom));
+            n_found++;
+        }
+
+        /* every root of the errata locator must be a codeword position */
+        return n_found == n_errata;
+    }
+};
+
+}
+
+#endif // RS16_HPP
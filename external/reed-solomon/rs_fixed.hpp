@@ -0,0 +1,372 @@
+/* Reed-Solomon codec specialized at compile time for a given message and ECC length
+ *
+ * Same code as RS::ReedSolomon - generator roots a^0 .. a^(ecc_length-1) over the 0x11d field,
+ * first byte of the codeword is the highest degree coefficient.
+ *
+ * See LICENSE */
+
+#ifndef RS_FIXED_HPP
+#define RS_FIXED_HPP
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "gf.hpp"
+#include "batch.hpp"
+
+namespace RS {
+
+namespace fixed {
+
+/* @brief Multiplication in Galua Fields without tables, usable in constant expressions */
+constexpr uint8_t mul(uint8_t x, uint8_t y) {
+    uint8_t r = 0;
+    while(y) {
+        if(y & 1) r ^= x;
+        x = (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1d : 0));
+        y >>= 1;
+    }
+    return r;
+}
+
+/* g(x) = (x + a^0)(x + a^1)...(x + a^(Ecc-1)), highest degree first */
+template<int Ecc>
+struct Generator {
+    uint8_t coef[Ecc + 1];
+
+    constexpr Generator() : coef() {
+        coef[0] = 1;
+        uint8_t root = 1;
+        for(int i = 0; i < Ecc; i++){
+            for(int j = i + 1; j > 0; j--){
+                coef[j] ^= mul(coef[j - 1], root);
+            }
+            root = mul(root, 2);
+        }
+    }
+};
+
+/* power[i][k] = a^(k*(N-1-i)) - contribution of codeword byte i to syndrome k */
+template<int N, int Ecc>
+struct SyndromePowers {
+    uint8_t power[N][Ecc];
+
+    constexpr SyndromePowers() : power() {
+        uint8_t x = 1;
+        for(int i = N - 1; i >= 0; i--){
+            uint8_t p = 1;
+            for(int k = 0; k < Ecc; k++){
+                power[i][k] = p;
+                p = mul(p, x);
+            }
+            x = mul(x, 2);
+        }
+    }
+};
+
+/* products of every byte with the generator coefficients and with the syndrome roots */
+template<int Ecc>
+struct ProductTables {
+    uint8_t gen[Ecc][256];
+    uint8_t root[Ecc][256];
+
+    constexpr ProductTables() : gen(), root() {
+        Generator<Ecc> g;
+        uint8_t r = 1;
+        for(int k = 0; k < Ecc; k++){
+            for(int x = 0; x < 256; x++){
+                gen[k][x] = mul(g.coef[k + 1], x);
+                root[k][x] = mul(r, x);
+            }
+            r = mul(r, 2);
+        }
+    }
+};
+
+/* Short ECC (up to kMaxTableEcc bytes) goes through one product table lookup per byte,
+ * longer ECC through the SIMD region kernels of gf.hpp */
+constexpr int kMaxTableEcc = 16;
+
+template<int Msg, int Ecc>
+class ReedSolomon {
+public:
+    static_assert(Msg > 0 && Ecc > 0 && Msg + Ecc < 256, "Invalid Reed-Solomon code");
+
+    static constexpr int msg_length = Msg;
+    static constexpr int ecc_length = Ecc;
+    static constexpr int length = Msg + Ecc;
+
+    /* @brief Message block encoding
+     * @param *src - input message buffer      (msg_length size)
+     * @param *dst - output buffer for ecc     (ecc_length size at least) */
+    void EncodeBlock(const void* src, void* dst) const {
+        const uint8_t *msg = (const uint8_t*) src;
+
+        if(Ecc < kMaxTableEcc) {
+            /* remainder of the division by the generator, shifted one byte per message byte */
+            uint8_t rem[Ecc];
+            memset(rem, 0, sizeof(rem));
+            for(int i = 0; i < Msg; i++){
+                uint8_t coef = msg[i] ^ rem[0];
+                for(int j = 0; j < Ecc - 1; j++){
+                    rem[j] = rem[j + 1] ^ tables.gen[j][coef];
+                }
+                rem[Ecc - 1] = tables.gen[Ecc - 1][coef];
+            }
+            memcpy(dst, rem, Ecc);
+            return;
+        }
+
+        /* synthetic division in place */
+        uint8_t buf[length];
+        memcpy(buf, msg, Msg);
+        memset(buf + Msg, 0, Ecc);
+        for(int i = 0; i < Msg; i++){
+            gf::mul_add_region(buf[i], generator.coef + 1, buf + i + 1, Ecc);
+        }
+        memcpy(dst, buf + Msg, Ecc);
+    }
+
+    /* @brief Message encoding
+     * @param *src - input message buffer      (msg_length size)
+     * @param *dst - output buffer             (msg_length + ecc_length size at least) */
+    void Encode(const void* src, void* dst) const {
+        uint8_t *dst_ptr = (uint8_t*) dst;
+
+        memcpy(dst_ptr, src, Msg);
+        EncodeBlock(src, dst_ptr + Msg);
+    }
+
+    /* @brief Message block decoding
+     * @param *src         - encoded message buffer   (msg_length size)
+     * @param *ecc         - ecc buffer               (ecc_length size)
+     * @param *dst         - output buffer            (msg_length size at least)
+     * @param *erase_pos   - known errors positions
+     * @param erase_count  - count of known errors
+     * @return 0 if successfull, error code otherwise */
+    int DecodeBlock(const void* src, const void* ecc, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        uint8_t cw[length];
+        memcpy(cw, src, Msg);
+        memcpy(cw + Msg, ecc, Ecc);
+
+        if(erase_count > (size_t) Ecc) return 1;
+        for(size_t i = 0; i < erase_count; i++){
+            if(erase_pos[i] >= length) return 1;
+            cw[erase_pos[i]] = 0;
+        }
+
+        /* syndromes, lowest degree first */
+        uint8_t synd[Ecc];
+        memset(synd, 0, sizeof(synd));
+        if(Ecc < kMaxTableEcc) {
+            /* Horner's scheme for all roots at once */
+            for(int i = 0; i < length; i++){
+                for(int k = 0; k < Ecc; k++){
+                    synd[k] = tables.root[k][synd[k]] ^ cw[i];
+                }
+            }
+        } else {
+            for(int i = 0; i < length; i++){
+                gf::mul_add_region(cw[i], powers.power[i], synd, Ecc);
+            }
+        }
+
+        bool has_errors = false;
+        for(int k = 0; k < Ecc; k++){
+            if(synd[k] != 0) {
+                has_errors = true;
+                break;
+            }
+        }
+
+        if(has_errors) {
+            if(!Correct(cw, synd, erase_pos, (int) erase_count)) return 1;
+        }
+
+        memcpy(dst, cw, Msg);
+        return 0;
+    }
+
+    /* @brief Message block decoding
+     * @param *src         - encoded message buffer   (msg_length + ecc_length size)
+     * @param *dst         - output buffer            (msg_length size at least)
+     * @param *erase_pos   - known errors positions
+     * @param erase_count  - count of known errors
+     * @return 0 if successfull, error code otherwise */
+    int Decode(const void* src, void* dst, const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        const uint8_t *src_ptr = (const uint8_t*) src;
+        return DecodeBlock(src_ptr, src_ptr + Msg, dst, erase_pos, erase_count);
+    }
+
+    /* @brief Encoding of count messages
+     * @param *src   - input messages back to back   (count * msg_length size)
+     * @param *dst   - output codewords back to back (count * (msg_length + ecc_length) size at least)
+     * @param count  - number of messages */
+    void EncodeBatch(const void* src, void* dst, size_t count) const {
+        batch::Encode(generator.coef, Msg, Ecc, (const uint8_t*) src, (uint8_t*) dst, count);
+    }
+
+    /* @brief Decoding of count codewords - only the ones with non-zero syndromes go through DecodeBlock,
+     *        every one of them when there are erasures
+     * @param *src         - encoded messages back to back (count * (msg_length + ecc_length) size)
+     * @param *dst         - output buffer                 (count * msg_length size at least)
+     * @param count        - number of codewords
+     * @param *result      - 0 or the error code of every codeword (count size, may be NULL)
+     * @param *erase_pos   - known errors positions, the same in every codeword
+     * @param erase_count  - count of known errors
+     * @return number of codewords that failed to decode */
+    size_t DecodeBatch(const void* src, void* dst, size_t count, int* result = NULL,
+                       const uint8_t* erase_pos = NULL, size_t erase_count = 0) const {
+        const uint8_t *src_ptr = (const uint8_t*) src;
+        uint8_t *dst_ptr = (uint8_t*) dst;
+
+        auto decode = [&](const uint8_t *cw, uint8_t *msg) {
+            return DecodeBlock(cw, cw + Msg, msg, erase_pos, erase_count);
+        };
+
+        if(erase_count == 0) {
+            return batch::Decode(&powers.power[0][0], Msg, Ecc, src_ptr, dst_ptr, count, result, decode);
+        }
+
+        size_t n_failed = 0;
+        for(size_t i = 0; i < count; i++){
+            int res = decode(src_ptr + i * length, dst_ptr + i * Msg);
+            if(res != 0) n_failed++;
+            if(result != NULL) result[i] = res;
+        }
+        return n_failed;
+    }
+
+private:
+    static constexpr Generator<Ecc> generator{};
+    static constexpr SyndromePowers<Msg + Ecc, Ecc> powers{};
+    static constexpr ProductTables<Ecc> tables{};
+
+    /* a^(N-1-i) - locator of codeword byte i */
+    static uint8_t Locator(int i) {
+        return gf::exp[(length - 1 - i) % 255];
+    }
+
+    /* p(x) evaluated at x, lowest degree first */
+    static uint8_t Eval(const uint8_t *p, int n, uint8_t x) {
+        uint8_t y = 0;
+        for(int i = n - 1; i >= 0; i--){
+            y = gf::mul(y, x) ^ p[i];
+        }
+        return y;
+    }
+
+    /* Errors-and-erasures decoding: Forney syndromes, Berlekamp-Massey, Chien search, Forney algorithm */
+    static bool Correct(uint8_t *cw, const uint8_t *synd, const uint8_t *erase_pos, int erase_count) {
+        /* erasure locator Gamma(x) = prod(1 + X_j x) */
+        uint8_t gamma[Ecc + 1];
+        memset(gamma, 0, sizeof(gamma));
+        gamma[0] = 1;
+        for(int j = 0; j < erase_count; j++){
+            uint8_t x = Locator(erase_pos[j]);
+            for(int i = j + 1; i > 0; i--){
+                gamma[i] ^= gf::mul(gamma[i - 1], x);
+            }
+        }
+
+        /* Forney syndromes Gamma(x)S(x) mod x^Ecc - the errors are located with the last Ecc - erase_count of them */
+        uint8_t fsynd[Ecc];
+        memset(fsynd, 0, sizeof(fsynd));
+        for(int i = 0; i <= erase_count; i++){
+            gf::mul_add_region(gamma[i], synd, fsynd + i, Ecc - i);
+        }
+
+        /* Berlekamp-Massey for the error locator sigma(x) */
+        uint8_t sigma[Ecc + 1];
+        uint8_t prev[Ecc + 1];
+        uint8_t temp[Ecc + 1];
+        memset(sigma, 0, sizeof(sigma));
+        memset(prev, 0, sizeof(prev));
+        sigma[0] = 1;
+        prev[0] = 1;
+
+        int L = 0;
+        int m = 1;
+        uint8_t b = 1;
+        const int n_synd = Ecc - erase_count;
+        const uint8_t *s = fsynd + erase_count;
+        for(int r = 0; r < n_synd; r++){
+            uint8_t delta = s[r];
+            for(int i = 1; i <= L; i++){
+                delta ^= gf::mul(sigma[i], s[r - i]);
+            }
+
+            if(delta == 0) {
+                m++;
+                continue;
+            }
+
+            uint8_t coef = gf::div(delta, b);
+            if(2*L <= r) {
+                memcpy(temp, sigma, sizeof(sigma));
+                gf::mul_add_region(coef, prev, sigma + m, Ecc + 1 - m);
+                L = r + 1 - L;
+                memcpy(prev, temp, sizeof(prev));
+                b = delta;
+                m = 1;
+            } else {
+                gf::mul_add_region(coef, prev, sigma + m, Ecc + 1 - m);
+                m++;
+            }
+        }
+
+        if(2*L + erase_count > Ecc) return false;
+
+        /* errata locator Lambda(x) = sigma(x)Gamma(x) */
+        uint8_t lambda[Ecc + 1];
+        memset(lambda, 0, sizeof(lambda));
+        const int n_errata = L + erase_count;
+        for(int i = 0; i <= L; i++){
+            gf::mul_add_region(sigma[i], gamma, lambda + i, erase_count + 1);
+        }
+
+        /* error evaluator Omega(x) = S(x)Lambda(x) mod x^Ecc */
+        uint8_t omega[Ecc];
+        memset(omega, 0, sizeof(omega));
+        for(int i = 0; i <= n_errata && i < Ecc; i++){
+            gf::mul_add_region(lambda[i], synd, omega + i, Ecc - i);
+        }
+
+        /* formal derivative - only the odd powers survive in characteristic 2 */
+        uint8_t lambda_prime[Ecc + 1];
+        memset(lambda_prime, 0, sizeof(lambda_prime));
+        for(int i = 1; i <= n_errata; i += 2){
+            lambda_prime[i - 1] = lambda[i];
+        }
+
+        int n_found = 0;
+        for(int i = 0; i < length; i++){
+            uint8_t x = Locator(i);
+            uint8_t x_inv = gf::inverse(x);
+            if(Eval(lambda, n_errata + 1, x_inv) != 0) continue;
+
+            uint8_t denom = Eval(lambda_prime, n_errata, x_inv);
+            if(denom == 0) return false;
+
+            cw[i] ^= gf::mul(x, gf::div(Eval(omega, Ecc, x_inv), denom));
+            n_found++;
+        }
+
+        /* every root of the errata locator must be a codeword position */
+        return n_found == n_errata;
+    }
+};
+
+template<int Msg, int Ecc>
+constexpr Generator<Ecc> ReedSolomon<Msg, Ecc>::generator;
+
+template<int Msg, int Ecc>
+constexpr SyndromePowers<Msg + Ecc, Ecc> ReedSolomon<Msg, Ecc>::powers;
+
+template<int Msg, int Ecc>
+constexpr ProductTables<Ecc> ReedSolomon<Msg, Ecc>::tables;
+
+} /* end of fixed namespace */
+
+}
+
+#endif // RS_FIXED_HPP
@@ -11,6 +11,9 @@
 
 #include "ui.h"
 #include "core.h"
+#include "data.h"
+
+#include <fstream>
 
 namespace {
 }
@@ -35,7 +38,39 @@ App::App(const Parameters & params) {
     _ui->setEventCallback(UI::BUTTON_DATA_OFF, [this]() { _core->addEvent(Core::DataOff); });
     _ui->setEventCallback(UI::BUTTON_DATA_TAP, [this]() { _core->addEvent(Core::DataTap); });
     _ui->setEventCallback(UI::BUTTON_DATA_SEND, [this]() { _core->addEvent(Core::DataSend); });
+    _ui->setEventCallback(UI::BUTTON_DATA_QUEUE, [this]() { _core->addEvent(Core::DataQueue); });
     _ui->setEventCallback(UI::BUTTON_DATA_CLEAR, [this]() { _core->addEvent(Core::DataClear); });
+    _ui->setEventCallback(UI::BUTTON_LINK_REPORT, [this]() { _core->addEvent(Core::DataLinkReport); });
+    _ui->setEventCallback(UI::BUTTON_SEND_FILE, [this]() {
+        auto inp = _ui->getStateInput().lock();
+        if (inp == nullptr) return;
+
+        auto file = std::make_shared<std::ifstream>(inp->sendFilePath.data(), std::ios::binary);
+        if (file->is_open() == false) {
+            CG_WARN(0, "Unable to open '%s' for reading\n", inp->sendFilePath.data());
+            return;
+        }
+
+        _core->sendStream([file](std::uint8_t * dst, int n) {
+            file->read((char *) dst, n);
+            return (int) file->gcount();
+        });
+    });
+    _ui->setEventCallback(UI::BUTTON_RECEIVE_FILE, [this]() {
+        auto inp = _ui->getStateInput().lock();
+        if (inp == nullptr) return;
+
+        auto file = std::make_shared<std::ofstream>(inp->receiveFilePath.data(), std::ios::binary);
+        if (file->is_open() == false) {
+            CG_WARN(0, "Unable to open '%s' for writing\n", inp->receiveFilePath.data());
+            return;
+        }
+
+        _core->setReceiveSink([file](const std::uint8_t * src, int n, bool isEnd) {
+            file->write((const char *) src, n);
+            if (isEnd) file->flush();
+        });
+    });
 
     _ui->init(_window);
     _core->init();
@@ -0,0 +1,177 @@
+/*! \file arq.cpp
+ *  \brief Selective-repeat ARQ on top of the framed packet layer
+ *  \author Georgi Gerganov
+ */
+
+#include "arq.h"
+
+#include <algorithm>
+
+namespace {
+    constexpr std::uint32_t kAckMarker = 1 << 15;
+
+    // CRC-8, polynomial x^8 + x^2 + x + 1
+    std::uint8_t crc8(std::uint32_t x, int nBytes) {
+        std::uint8_t crc = 0;
+        for (int i = 0; i < nBytes; ++i) {
+            crc ^= (x >> (8*i)) & 0xFF;
+            for (int k = 0; k < 8; ++k) {
+                crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+            }
+        }
+        return crc;
+    }
+}
+
+std::uint32_t encodeAck(int base, int bitmap) {
+    std::uint32_t word = (base & kFrameSeqMask) | ((bitmap & 0xFF) << 7) | kAckMarker;
+    return word | (((std::uint32_t) ::crc8(word, 2)) << 16);
+}
+
+bool decodeAck(std::uint32_t word, int & base, int & bitmap) {
+    if ((word & kAckMarker) == 0) return false;
+    if (((word >> 16) & 0xFF) != ::crc8(word & 0xFFFF, 2)) return false;
+
+    base = word & kFrameSeqMask;
+    bitmap = (word >> 7) & 0xFF;
+
+    return true;
+}
+
+void ArqSender::startMessage() {
+    _window.clear();
+    _isMessageEnd = false;
+    _isFailed = false;
+}
+
+bool ArqSender::next(FrameEncoder & encoder, const FrameEncoder::Reader & read, std::uint8_t * dst, int frameSize, int & nRead) {
+    nRead = 0;
+    ++_txId;
+
+    for (const auto & frame : _window) {
+        if (frame.isAcked == false && _txId - frame.txFirst > kArqGiveUpTx) {
+            _isFailed = true;
+            _window.clear();
+            return false;
+        }
+    }
+
+    Frame * due = nullptr;
+    for (auto & frame : _window) {
+        if (frame.isAcked) continue;
+        if (frame.isMissing || _txId - frame.txLast >= kArqTimeoutTx) {
+            due = &frame;
+            break;
+        }
+    }
+
+    if (due) {
+        due->txLast = _txId;
+        due->isMissing = false;
+        ++_nRetransmissions;
+
+        _lastTx = due->bytes;
+    } else if ((int) _window.size() < kArqWindow && _isMessageEnd == false) {
+        Frame frame;
+        frame.bytes.resize(frameSize);
+        nRead = encoder.encode(read, frame.bytes.data(), frameSize);
+        frame.seq = frame.bytes[1] & kFrameSeqMask;
+        frame.txFirst = _txId;
+        frame.txLast = _txId;
+        _isMessageEnd = encoder.isMessageEnd();
+
+        _lastTx = frame.bytes;
+        _window.push_back(std::move(frame));
+    } else if (_window.empty()) {
+        // everything is acknowledged and the message has ended
+        return false;
+    }
+
+    std::copy(_lastTx.begin(), _lastTx.end(), dst);
+
+    return true;
+}
+
+void ArqSender::onAck(int base, int bitmap) {
+    if (_window.empty()) return;
+
+    // the window holds consecutive sequence numbers - anything else is about an older message
+    int nBefore = (base - _window.front().seq + kFrameSeqCount) % kFrameSeqCount;
+    if (nBefore > (int) _window.size()) return;
+
+    // frames between the base and the last one received are missing
+    int nReceived = 0;
+    for (int k = 0; k < kArqWindow - 1; ++k) {
+        if (bitmap & (1 << k)) nReceived = k + 2;
+    }
+
+    for (int i = 0; i < (int) _window.size(); ++i) {
+        auto & frame = _window[i];
+        int k = i - nBefore;
+        if (k < 0 || (k > 0 && (bitmap & (1 << (k - 1))))) {
+            frame.isAcked = true;
+        } else if (k < nReceived && _txId - frame.txLast >= kArqRoundTripTx) {
+            frame.isMissing = true;
+        }
+    }
+
+    while (_window.size() > 0 && _window.front().isAcked) {
+        _window.pop_front();
+    }
+}
+
+void ArqReceiver::reset() {
+    _isSynced = false;
+    _base = 0;
+    for (int i = 0; i < kArqWindow; ++i) {
+        _has[i] = false;
+        _frames[i].clear();
+    }
+}
+
+bool ArqReceiver::add(const std::uint8_t * frame, int frameSize) {
+    int seq = frame[1] & kFrameSeqMask;
+    bool isStart = (frame[1] & kFrameStartOfMessage) != 0;
+
+    // frames behind the base are repeats of delivered ones, a start ahead of it means that the sender
+    // gave up on the previous message
+    int offset = (seq - _base + kFrameSeqCount) % kFrameSeqCount;
+    if (_isSynced == false || (isStart && offset > 0 && offset < kFrameSeqCount/2)) {
+        if (isStart == false) return false;
+
+        reset();
+        _isSynced = true;
+        _base = seq;
+        offset = 0;
+    }
+
+    if (offset >= kArqWindow) return false;
+
+    int slot = seq % kArqWindow;
+    if (_has[slot]) return false;
+
+    _frames[slot].assign(frame, frame + frameSize);
+    _has[slot] = true;
+
+    return true;
+}
+
+bool ArqReceiver::next(std::vector<std::uint8_t> & frame) {
+    int slot = _base % kArqWindow;
+    if (_has[slot] == false) return false;
+
+    frame.swap(_frames[slot]);
+    _has[slot] = false;
+    _base = (_base + 1) % kFrameSeqCount;
+
+    return true;
+}
+
+std::uint32_t ArqReceiver::getAck() const {
+    int bitmap = 0;
+    for (int i = 0; i < kArqWindow - 1; ++i) {
+        if (_has[(_base + 1 + i) % kArqWindow]) bitmap |= 1 << i;
+    }
+
+    return ::encodeAck(_base, bitmap);
+}
@@ -0,0 +1,89 @@
+/*! \file arq.h
+ *  \brief Selective-repeat ARQ on top of the framed packet layer
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include "framing.h"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+// The receiver answers on its own band with an acknowledgement word, LSB first:
+// [next expected sequence number:7][bitmap:8][marker:1][CRC-8:8]
+// Bit i of the bitmap is set when frame base + 1 + i has already been received.
+
+constexpr int kArqWindow = 8;
+constexpr int kArqAckBits = 24;
+
+// Tx from sending a frame until its acknowledgement can be heard back - an acknowledgement younger than
+// that does not know about the last copy of the frame yet
+constexpr int kArqRoundTripTx = 4;
+
+// an unacknowledged frame that the bitmap says nothing about is sent again after this many Tx
+constexpr int kArqTimeoutTx = 2*kArqRoundTripTx;
+
+// the message is dropped once one of its frames has gone unacknowledged for this many Tx
+constexpr int kArqGiveUpTx = 8*kArqTimeoutTx;
+
+std::uint32_t encodeAck(int base, int bitmap);
+
+// false if the marker or the CRC-8 do not match
+bool decodeAck(std::uint32_t word, int & base, int & bitmap);
+
+// Keeps the frames of the window until they are acknowledged. A frame is sent again only when the bitmap
+// shows a later one received without it, or when it times out - while waiting the previous Tx is repeated,
+// which the receiver drops as a repeat.
+class ArqSender {
+public:
+    void startMessage();
+
+    // the frame for the next Tx - one that is due again, a new one while the window has room, otherwise a repeat
+    // returns false once every frame is acknowledged or one of them has gone unacknowledged for kArqGiveUpTx
+    bool next(FrameEncoder & encoder, const FrameEncoder::Reader & read, std::uint8_t * dst, int frameSize, int & nRead);
+
+    void onAck(int base, int bitmap);
+
+    bool isFailed() const { return _isFailed; }
+    int getRetransmissions() const { return _nRetransmissions; }
+
+private:
+    struct Frame {
+        std::vector<std::uint8_t> bytes;
+        int seq = 0;
+        int txFirst = 0;            // Tx of the first and of the last copy
+        int txLast = 0;
+        bool isAcked = false;
+        bool isMissing = false;     // a later frame has been acknowledged without this one
+    };
+
+    std::deque<Frame> _window;
+    std::vector<std::uint8_t> _lastTx;
+    bool _isMessageEnd = false;
+    bool _isFailed = false;
+    int _txId = 0;
+    int _nRetransmissions = 0;
+};
+
+// Buffers out of order frames of the window and releases them in sequence order
+class ArqReceiver {
+public:
+    void reset();
+
+    // returns false for repeats and for frames outside of the window
+    bool add(const std::uint8_t * frame, int frameSize);
+
+    // the next frame in sequence order, once it has been received
+    bool next(std::vector<std::uint8_t> & frame);
+
+    bool isSynced() const { return _isSynced; }
+    std::uint32_t getAck() const;
+
+private:
+    bool _isSynced = false;
+    int _base = 0;
+    bool _has[kArqWindow] = {};
+    std::vector<std::uint8_t> _frames[kArqWindow];
+};
@@ -0,0 +1,175 @@
+/*! \file compress.cpp
+ *  \brief Streaming LZSS codec with a static dictionary for text payloads
+ *  \author Georgi Gerganov
+ */
+
+#include "compress.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    constexpr int kMinMatch = 3;
+    constexpr int kMaxMatch = kMinMatch + 15;
+    constexpr int kHashSize = 4096;
+    constexpr int kMaxChainLength = 64;
+
+    // common words and fragments of ASCII messages and telemetry - the most frequent ones last, closest to the data
+    const char kDictionary[] =
+        "http://https://www..com.org.net/index.html?id=&name=value\"error\":\"warning\":\"info\":\"debug\":"
+        "{\"type\":\"message\",\"data\":\"timestamp\":\"status\":\"ok\"}[{\"},{\"true,false,null,"
+        "latitude longitude altitude heading speed distance position location gps sat fix "
+        "temperature humidity pressure voltage current power battery level signal rssi snr "
+        "sensor device node channel frequency sample rate count total average minimum maximum "
+        "January February March April May June July August September October November December "
+        "Monday Tuesday Wednesday Thursday Friday Saturday Sunday "
+        "The This That There These They Then When Where What Which Who How Please Thank you "
+        "have has had will would could should about after before because between from with without "
+        "which that this there their they them then than what when where while your you are were "
+        "the and for not but all any can her was one our out day get him his how man new now old "
+        "see two way who boy did its let put say she too use ing ion ent ter est ers ere "
+        "00:00:00 0.00 1.00 10 100 1000 %, C, V, mA, dB, Hz, ms, s, m, km, kg, "
+        " = ; : , . - / \r\n\n\t  the  of  to  and  a  in  is  it  that  for ";
+
+    inline int hash3(const std::uint8_t * p) {
+        return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (kHashSize - 1);
+    }
+}
+
+Compressor::Compressor() :
+    _buffer(kDictionary, kDictionary + sizeof(kDictionary) - 1),
+    _head(kHashSize, -1),
+    _prev(kCompressWindowSize, -1) {
+    _pos = _buffer.size();
+}
+
+void Compressor::put(const std::uint8_t * src, int n, std::vector<std::uint8_t> & out) {
+    _buffer.insert(_buffer.end(), src, src + n);
+    encode(false, out);
+}
+
+void Compressor::finish(std::vector<std::uint8_t> & out) {
+    encode(true, out);
+
+    if (_nItems > 0) {
+        out.insert(out.end(), _group.begin(), _group.end());
+        _group.clear();
+        _nItems = 0;
+    }
+}
+
+void Compressor::insert(int pos) {
+    int i = pos - _base;
+    int h = ::hash3(_buffer.data() + i);
+    _prev[pos & (kCompressWindowSize - 1)] = _head[h];
+    _head[h] = pos;
+}
+
+void Compressor::addItem(bool isLiteral, std::vector<std::uint8_t> & out) {
+    if (isLiteral) _group[0] |= (1 << _nItems);
+    if (++_nItems == 8) {
+        out.insert(out.end(), _group.begin(), _group.end());
+        _group.clear();
+        _nItems = 0;
+    }
+}
+
+void Compressor::encode(bool flush, std::vector<std::uint8_t> & out) {
+    int end = _base + (int) _buffer.size();
+
+    // without flushing, keep enough lookahead for the longest match
+    int last = flush ? end : end - kMaxMatch;
+
+    while (_pos < last) {
+        // positions before _pos that can start a 3-byte sequence go into the hash chains
+        while (_nInserted < _pos && _nInserted + kMinMatch <= end) {
+            insert(_nInserted++);
+        }
+
+        const std::uint8_t * cur = _buffer.data() + (_pos - _base);
+        int nAvail = std::min(kMaxMatch, end - _pos);
+
+        int bestLen = 0;
+        int bestDist = 0;
+        if (nAvail >= kMinMatch) {
+            int cand = _head[::hash3(cur)];
+            for (int depth = 0; depth < kMaxChainLength && cand >= 0 && _pos - cand <= kCompressWindowSize; ++depth) {
+                const std::uint8_t * ref = _buffer.data() + (cand - _base);
+                int len = 0;
+                while (len < nAvail && ref[len] == cur[len]) ++len;
+                if (len > bestLen) {
+                    bestLen = len;
+                    bestDist = _pos - cand;
+                    if (len == nAvail) break;
+                }
+                int next = _prev[cand & (kCompressWindowSize - 1)];
+                if (next >= cand) break;
+                cand = next;
+            }
+        }
+
+        if (_nItems == 0) _group.push_back(0);
+
+        if (bestLen >= kMinMatch) {
+            int d = bestDist - 1;
+            _group.push_back(d & 0xFF);
+            _group.push_back(((d >> 8) << 4) | (bestLen - kMinMatch));
+            addItem(false, out);
+            _pos += bestLen;
+        } else {
+            _group.push_back(*cur);
+            addItem(true, out);
+            _pos += 1;
+        }
+    }
+
+    // drop data that has left the window
+    int nDrop = (_pos - _base) - 2*kCompressWindowSize;
+    if (nDrop > 0) {
+        _buffer.erase(_buffer.begin(), _buffer.begin() + nDrop);
+        _base += nDrop;
+    }
+}
+
+Decompressor::Decompressor() {
+    _window.fill(0);
+    for (int i = 0; i < (int) sizeof(kDictionary) - 1; ++i) {
+        _window[_windowPos] = kDictionary[i];
+        _windowPos = (_windowPos + 1) & (kCompressWindowSize - 1);
+    }
+}
+
+void Decompressor::output(std::uint8_t c, std::vector<std::uint8_t> & out) {
+    out.push_back(c);
+    _window[_windowPos] = c;
+    _windowPos = (_windowPos + 1) & (kCompressWindowSize - 1);
+}
+
+void Decompressor::put(const std::uint8_t * src, int n, std::vector<std::uint8_t> & out) {
+    for (int i = 0; i < n; ++i) {
+        std::uint8_t c = src[i];
+
+        if (_nFlagsLeft == 0) {
+            _flags = c;
+            _nFlagsLeft = 8;
+            continue;
+        }
+
+        if (_flags & 1) {
+            output(c, out);
+        } else if (_pending < 0) {
+            _pending = c;
+            continue;
+        } else {
+            int d = (_pending | ((c >> 4) << 8)) + 1;
+            int len = (c & 0x0F) + kMinMatch;
+            for (int j = 0; j < len; ++j) {
+                output(_window[(_windowPos - d) & (kCompressWindowSize - 1)], out);
+            }
+            _pending = -1;
+        }
+
+        _flags >>= 1;
+        --_nFlagsLeft;
+    }
+}
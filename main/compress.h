@@ -0,0 +1,57 @@
+/*! \file compress.h
+ *  \brief Streaming LZSS codec with a static dictionary for text payloads
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// Format: groups of a flag byte followed by up to 8 items, LSB first.
+// A set flag bit is a literal byte, a cleared one a 2-byte match of 12-bit distance and 4-bit length.
+// Both sides start with the window primed with the same dictionary.
+
+constexpr int kCompressWindowSize = 4096;
+
+class Compressor {
+public:
+    Compressor();
+
+    void put(const std::uint8_t * src, int n, std::vector<std::uint8_t> & out);
+    void finish(std::vector<std::uint8_t> & out);
+
+private:
+    void encode(bool flush, std::vector<std::uint8_t> & out);
+    void insert(int pos);
+    void addItem(bool isLiteral, std::vector<std::uint8_t> & out);
+
+    std::vector<std::uint8_t> _buffer;
+    int _base = 0;
+    int _pos = 0;
+    int _nInserted = 0;
+
+    std::vector<int> _head;
+    std::vector<int> _prev;
+
+    std::vector<std::uint8_t> _group;
+    int _nItems = 0;
+};
+
+class Decompressor {
+public:
+    Decompressor();
+
+    void put(const std::uint8_t * src, int n, std::vector<std::uint8_t> & out);
+
+private:
+    void output(std::uint8_t c, std::vector<std::uint8_t> & out);
+
+    std::array<std::uint8_t, kCompressWindowSize> _window;
+    int _windowPos = 0;
+
+    int _flags = 0;
+    int _nFlagsLeft = 0;
+    int _pending = -1;
+};
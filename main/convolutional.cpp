@@ -0,0 +1,154 @@
+/*! \file convolutional.cpp
+ *  \brief K=7 rate 1/2 convolutional inner code with a soft-decision Viterbi decoder
+ *  \author Georgi Gerganov
+ */
+
+#include "convolutional.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr int kStates = 64;
+    constexpr int kPolyA = 0171;
+    constexpr int kPolyB = 0133;
+
+    // path metrics of unreachable states - far below any reachable one, far from overflowing
+    constexpr std::int16_t kMetricMin = -16384;
+
+    inline int parity(int x) {
+        x ^= x >> 4;
+        x ^= x >> 2;
+        x ^= x >> 1;
+        return x & 1;
+    }
+
+    // Both generators tap the oldest and the newest bit, so the butterfly of old states i and i + 32
+    // into new states 2i and 2i + 1 has a single branch metric up to sign: that of state i with input 0.
+    // sign[i] = +1 / -1 for each of the two coded bits of that branch.
+    struct Butterflies {
+        std::int16_t signA[kStates/2];
+        std::int16_t signB[kStates/2];
+
+        Butterflies() {
+            for (int i = 0; i < kStates/2; ++i) {
+                int reg = i << 1;
+                signA[i] = parity(reg & kPolyA) ? 1 : -1;
+                signB[i] = parity(reg & kPolyB) ? 1 : -1;
+            }
+        }
+    };
+
+    const Butterflies & getButterflies() {
+        static const Butterflies butterflies;
+        return butterflies;
+    }
+
+    inline int getBit(const std::uint8_t * src, int i) {
+        return (src[i/8] >> (i%8)) & 1;
+    }
+
+    // one trellis step: new metrics of the 64 states and a bit per state telling which predecessor won
+    inline std::uint64_t step(const std::int16_t * metric, std::int16_t * next, int softA, int softB) {
+        const auto & bf = getButterflies();
+        std::uint64_t decisions = 0;
+
+#if defined(__SSE2__)
+        const __m128i a = _mm_set1_epi16((std::int16_t) softA);
+        const __m128i b = _mm_set1_epi16((std::int16_t) softB);
+        for (int i = 0; i < kStates/2; i += 8) {
+            __m128i sa = _mm_loadu_si128((const __m128i *) (bf.signA + i));
+            __m128i sb = _mm_loadu_si128((const __m128i *) (bf.signB + i));
+            __m128i bm = _mm_add_epi16(_mm_mullo_epi16(sa, a), _mm_mullo_epi16(sb, b));
+
+            __m128i lo = _mm_loadu_si128((const __m128i *) (metric + i));
+            __m128i hi = _mm_loadu_si128((const __m128i *) (metric + i + kStates/2));
+
+            // new state 2i: lo + bm or hi - bm, new state 2i + 1: lo - bm or hi + bm
+            __m128i m0lo = _mm_add_epi16(lo, bm);
+            __m128i m0hi = _mm_sub_epi16(hi, bm);
+            __m128i m1lo = _mm_sub_epi16(lo, bm);
+            __m128i m1hi = _mm_add_epi16(hi, bm);
+
+            __m128i d0 = _mm_cmpgt_epi16(m0hi, m0lo);
+            __m128i d1 = _mm_cmpgt_epi16(m1hi, m1lo);
+            __m128i n0 = _mm_max_epi16(m0lo, m0hi);
+            __m128i n1 = _mm_max_epi16(m1lo, m1hi);
+
+            _mm_storeu_si128((__m128i *) (next + 2*i), _mm_unpacklo_epi16(n0, n1));
+            _mm_storeu_si128((__m128i *) (next + 2*i + 8), _mm_unpackhi_epi16(n0, n1));
+
+            __m128i d = _mm_packs_epi16(_mm_unpacklo_epi16(d0, d1), _mm_unpackhi_epi16(d0, d1));
+            decisions |= ((std::uint64_t) (std::uint16_t) _mm_movemask_epi8(d)) << (2*i);
+        }
+#else
+        for (int i = 0; i < kStates/2; ++i) {
+            int bm = bf.signA[i]*softA + bf.signB[i]*softB;
+            int lo = metric[i];
+            int hi = metric[i + kStates/2];
+
+            int m0lo = lo + bm, m0hi = hi - bm;
+            int m1lo = lo - bm, m1hi = hi + bm;
+
+            next[2*i]     = std::max(m0lo, m0hi);
+            next[2*i + 1] = std::max(m1lo, m1hi);
+            if (m0hi > m0lo) decisions |= (std::uint64_t) 1 << (2*i);
+            if (m1hi > m1lo) decisions |= (std::uint64_t) 1 << (2*i + 1);
+        }
+#endif
+
+        return decisions;
+    }
+}
+
+int ConvolutionalCode::getInfoBytes(int nCodedBits) {
+    return std::max(0, (nCodedBits/2 - kTailBits)/8);
+}
+
+void ConvolutionalCode::encode(const std::uint8_t * src, int nInfoBytes, std::uint8_t * dst) {
+    int nSteps = 8*nInfoBytes + kTailBits;
+    std::fill(dst, dst + (2*nSteps + 7)/8, 0);
+
+    int reg = 0;
+    for (int t = 0; t < nSteps; ++t) {
+        int bit = (t < 8*nInfoBytes) ? getBit(src, t) : 0;
+        reg = ((reg << 1) | bit) & 0x7F;
+        if (parity(reg & kPolyA)) dst[(2*t)/8]     |= 1 << ((2*t)%8);
+        if (parity(reg & kPolyB)) dst[(2*t + 1)/8] |= 1 << ((2*t + 1)%8);
+    }
+}
+
+void ConvolutionalCode::decode(const std::int8_t * soft, int nInfoBytes, std::uint8_t * dst) {
+    if (nInfoBytes <= 0) return;
+
+    int nSteps = 8*nInfoBytes + kTailBits;
+    _decisions.resize(nSteps);
+
+    alignas(16) std::int16_t metric[kStates];
+    alignas(16) std::int16_t next[kStates];
+    std::fill(metric, metric + kStates, kMetricMin);
+    metric[0] = 0;
+
+    for (int t = 0; t < nSteps; ++t) {
+        _decisions[t] = step(metric, next, soft[2*t], soft[2*t + 1]);
+
+        // keep the metrics around zero - their spread is bounded by the trellis depth
+        std::int16_t best = *std::max_element(next, next + kStates);
+        for (int s = 0; s < kStates; ++s) {
+            metric[s] = std::max<int>(kMetricMin, next[s] - best);
+        }
+    }
+
+    // the tail brings the encoder back to state 0
+    std::fill(dst, dst + nInfoBytes, 0);
+    int state = 0;
+    for (int t = nSteps - 1; t >= 0; --t) {
+        int bit = state & 1;
+        int upper = (_decisions[t] >> state) & 1;
+        if (t < 8*nInfoBytes && bit) dst[t/8] |= 1 << (t%8);
+        state = (state >> 1) | (upper << 5);
+    }
+}
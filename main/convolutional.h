@@ -0,0 +1,31 @@
+/*! \file convolutional.h
+ *  \brief K=7 rate 1/2 convolutional inner code with a soft-decision Viterbi decoder
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Generators 171 and 133 (octal). The trellis starts and ends in state 0 - every block of info bits
+// is followed by 6 zero tail bits. Bits are taken LSB first, the coded bits are packed the same way.
+// Soft inputs are one value per coded bit in [-127, 127]: positive for a 1, the magnitude is the confidence.
+
+class ConvolutionalCode {
+public:
+    static constexpr int kTailBits = 6;
+
+    // whole info bytes that fit in nCodedBits coded bits, tail included
+    static int getInfoBytes(int nCodedBits);
+
+    // 2*(8*nInfoBytes + kTailBits) coded bits into dst, the rest of the last byte is zero
+    static void encode(const std::uint8_t * src, int nInfoBytes, std::uint8_t * dst);
+
+    // maximum-likelihood info bytes for 2*(8*nInfoBytes + kTailBits) soft values
+    void decode(const std::int8_t * soft, int nInfoBytes, std::uint8_t * dst);
+
+private:
+    // bit s of decisions[t] - new state s at step t came from the upper predecessor
+    std::vector<std::uint64_t> _decisions;
+};
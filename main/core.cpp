@@ -6,25 +6,39 @@
 #include "core.h"
 
 #include "data.h"
+#include "ofdm.h"
+#include "compress.h"
+#include "rate_control.h"
+#include "ecc.h"
+#include "fountain.h"
+#include "convolutional.h"
+#include "framing.h"
+#include "arq.h"
 
 #include "cg_logger.h"
 #include "cg_ring_buffer.h"
+#include "cg_triple_buffer.h"
 
 #include "fftw3.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_audio.h>
 
-#include "reed-solomon/rs.hpp"
-
 #include <cmath>
+#include <complex>
 #include <thread>
-#include <mutex>
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <cstdlib>
 #include <cinttypes>
 #include <functional>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <map>
 
 #ifdef __EMSCRIPTEN__
 static bool g_isInitialized = false;
@@ -33,6 +47,29 @@ static bool g_isInitialized = true;
 #endif
 
 namespace {
+    // first byte of every Tx chunk: number of payload bytes and an end-of-stream flag
+    constexpr std::uint8_t kChunkSizeMask = 0x7F;
+    constexpr std::uint8_t kChunkEndOfStream = 0x80;
+
+    // first payload byte of every stream: flags describing the encoding of the rest and
+    // an optional rate report - 1 + the ladder step that the sender asks its peer to switch to
+    constexpr std::uint8_t kStreamCompressed = 0x01;
+    constexpr std::uint8_t kStreamRateMask = 0xF0;
+    constexpr int kStreamRateShift = 4;
+
+    // header of every fountain Tx: [number of source symbols][generation:4 | symbol id:12 (hi)][symbol id (lo)]
+    constexpr int kFountainHeaderSize = 3;
+    constexpr int kFountainGenerations = 16;
+
+    // both ends switch profile once the link has been quiet for this long after a rate report
+    constexpr int kRateSwitchDelay_ms = 500;
+
+    // the ARQ receiver keeps acknowledging for this long after the last frame
+    constexpr int kArqAckHold_ms = 3000;
+
+    // the worker gives up waiting for captured samples after this long, so that it can notice a shutdown
+    constexpr int kCaptureTimeout_ms = 100;
+
     constexpr float IRAND_MAX = 1.0f/RAND_MAX;
     inline float frand() { return ((float)(rand()%RAND_MAX)*IRAND_MAX); }
 
@@ -41,12 +78,129 @@ namespace {
         bdst->samplesPerFrame = bsrc->samplesPerFrame;
         bdst->samplesPerSubFrame = bsrc->samplesPerSubFrame;
         bdst->sendingData = bsrc->sendingData;
+        bdst->sendingDataBuffer = bsrc->sendingDataBuffer;
+        bdst->nQueuedMessages = bsrc->nQueuedMessages;
+        bdst->nBytesSent = bsrc->nBytesSent;
+        bdst->nBytesReceived = bsrc->nBytesReceived;
+        bdst->nMessagesReceived = bsrc->nMessagesReceived;
+        bdst->nMessagesCorrupted = bsrc->nMessagesCorrupted;
+        bdst->nRetransmissions = bsrc->nRetransmissions;
+        bdst->linkQuality = bsrc->linkQuality;
+        bdst->rateStepId = bsrc->rateStepId;
+        bdst->nRateChanges = bsrc->nRateChanges;
         bdst->receivingData = bsrc->receivingData;
-        bdst->sampleAmplitude = bsrc->sampleAmplitude;
-        bdst->sampleSpectrum = bsrc->sampleSpectrum;
-        bdst->historySpectrumAverage = bsrc->historySpectrumAverage;
-        bdst->bitAmplitude = bsrc->bitAmplitude;
-        bdst->receivedData = bsrc->receivedData;
+        bdst->frame = bsrc->frame;
+        bdst->tones = bsrc->tones;
+        bdst->received = bsrc->received;
+    }
+
+    // Newman phases keep the peak of a sum of equally spaced tones close to the RMS
+    inline float getTonePhase(int toneId, int nTones, bool usePAPRReduction) {
+        if (usePAPRReduction == false || nTones <= 0) return 2*M_PI*::frand();
+        return M_PI*((double) toneId*toneId)/nTones;
+    }
+
+    // prepends the stream flags and optionally compresses the payload on the fly
+    // the rate report is requested when the first chunk of the stream is read
+    inline Core::ByteSource makeStreamSource(Core::ByteSource && source, bool compress, std::function<std::uint8_t()> && getRateReport) {
+        struct State {
+            Core::ByteSource source;
+            std::function<std::uint8_t()> getRateReport;
+            bool compress = false;
+            bool headerSent = false;
+            bool inputEnded = false;
+            Compressor compressor;
+            std::vector<std::uint8_t> pending;
+            int pendingPos = 0;
+        };
+
+        auto state = std::make_shared<State>();
+        state->source = std::move(source);
+        state->getRateReport = std::move(getRateReport);
+        state->compress = compress;
+
+        return [state](std::uint8_t * dst, int n) {
+            int nWritten = 0;
+            if (state->headerSent == false && n > 0) {
+                std::uint8_t flags = state->compress ? kStreamCompressed : 0;
+                if (state->getRateReport) flags |= state->getRateReport();
+                dst[nWritten++] = flags;
+                state->headerSent = true;
+            }
+
+            if (state->compress == false) {
+                int res = (nWritten < n && state->source) ? state->source(dst + nWritten, n - nWritten) : 0;
+                return nWritten + std::max(0, res);
+            }
+
+            while (nWritten < n) {
+                if (state->pendingPos < (int) state->pending.size()) {
+                    int m = std::min(n - nWritten, (int) state->pending.size() - state->pendingPos);
+                    std::copy(state->pending.begin() + state->pendingPos, state->pending.begin() + state->pendingPos + m, dst + nWritten);
+                    state->pendingPos += m;
+                    nWritten += m;
+                    continue;
+                }
+                if (state->inputEnded) break;
+
+                state->pending.clear();
+                state->pendingPos = 0;
+
+                std::uint8_t buf[256];
+                int res = state->source ? state->source(buf, sizeof(buf)) : 0;
+                if (res <= 0) {
+                    state->inputEnded = true;
+                    state->compressor.finish(state->pending);
+                } else {
+                    state->compressor.put(buf, res, state->pending);
+                }
+            }
+
+            return nWritten;
+        };
+    }
+
+    struct StreamDecoder {
+        bool hasHeader = false;
+        bool isCompressed = false;
+        int rateReport = -1;
+        Decompressor decompressor;
+
+        void decode(const std::uint8_t * src, int n, std::vector<std::uint8_t> & out) {
+            if (n > 0 && hasHeader == false) {
+                isCompressed = (src[0] & kStreamCompressed) != 0;
+                int stepId = ((src[0] & kStreamRateMask) >> kStreamRateShift) - 1;
+                if (stepId < ::Data::Constants::kRateLadderSize) rateReport = stepId;
+                hasHeader = true;
+                ++src;
+                --n;
+            }
+
+            if (isCompressed) {
+                decompressor.put(src, n, out);
+            } else {
+                out.insert(out.end(), src, src + n);
+            }
+        }
+    };
+
+    // the text from the UI, up to the terminating zero
+    inline Core::ByteSource makeTextSource(const ::Data::SendData & text) {
+        auto data = std::make_shared<std::vector<std::uint8_t>>(text.begin(), std::find(text.begin(), text.end(), 0));
+        auto offset = std::make_shared<int>(0);
+
+        return [data, offset](std::uint8_t * dst, int n) {
+            n = std::min(n, (int) data->size() - *offset);
+            std::copy(data->begin() + *offset, data->begin() + *offset + n, dst);
+            *offset += n;
+            return n;
+        };
+    }
+
+    // detection margin of a bit in [-127, 127] from the evidence for either value - positive for a 1
+    inline std::int8_t getSoftBit(float one, float zero) {
+        float sum = std::fabs(one) + std::fabs(zero);
+        return (sum > 0.0f) ? (std::int8_t) std::lround(127.0f*(one - zero)/sum) : 0;
     }
 
     inline void addAmplitude(const ::Data::AmplitudeData & src, ::Data::AmplitudeData & dst, float scalar, int startId, int finalId) {
@@ -55,6 +209,92 @@ namespace {
         }
     }
 
+    struct RampEnvelope {
+        std::vector<float> up;
+        std::vector<float> down;
+    };
+
+    inline void buildRampEnvelope(int nFrames, int samplesPerSubFrame, ::Data::StateInput::RampShape shape, RampEnvelope & ramp) {
+        int n = nFrames*samplesPerSubFrame;
+        ramp.up.resize(n);
+        ramp.down.resize(n);
+        for (int i = 0; i < n; ++i) {
+            double t = ((double)(i + 1))/n;
+            if (shape == ::Data::StateInput::Ramp_RaisedCosine) {
+                t = 0.5 - 0.5*std::cos(M_PI*t);
+            }
+            ramp.up[i] = t;
+            ramp.down[n - 1 - i] = t;
+        }
+    }
+
+    // the batched RS calls work on byte columns with the GF(256) region kernels - with the scalar kernel
+    // they are slower than one call per codeword
+    inline bool useBatchRS() {
+        return RS::gf::simd_level() != RS::gf::SIMD_NONE;
+    }
+
+    inline void applyEnvelope(const float * src, const float * envelope, float * dst, int n) {
+        for (int i = 0; i < n; ++i) {
+            dst[i] = envelope[i]*src[i];
+        }
+    }
+
+    // The SDL capture callback pushes the recorded samples here and wakes up the worker, which sleeps until
+    // a whole sub-frame is available
+    struct Capture {
+        static constexpr int kBufferSize = 32*::Data::Constants::kMaxSamplesPerFrame;
+
+        CG::SPSCRingBuffer<float, kBufferSize> samples;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<int> nDropped { 0 };
+        std::atomic<bool> isWaiting { false };
+
+        // audio thread - never blocks
+        static void SDLCALL callback(void * userdata, Uint8 * stream, int len) {
+            auto & capture = *(Capture *) userdata;
+
+            int n = len/sizeof(float);
+            int nPushed = capture.samples.push((const float *) stream, n);
+            if (nPushed < n) capture.nDropped += n - nPushed;
+
+            // the fences make sure that either the worker sees the new samples or we see it waiting. A notification
+            // that comes right before the worker blocks is lost - the next callback, one period later, wakes it up
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (capture.isWaiting.load(std::memory_order_relaxed)) {
+                capture.cv.notify_one();
+            }
+        }
+
+        // worker thread - false if there are still less than n samples after timeout_ms
+        bool pop(float * dst, int n, int timeout_ms) {
+            if ((int) samples.size() < n) {
+                std::unique_lock<std::mutex> lock(mutex);
+                isWaiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool isReady = cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() { return (int) samples.size() >= n; });
+                isWaiting.store(false, std::memory_order_relaxed);
+                if (isReady == false) return false;
+            }
+            samples.pop(dst, n);
+            return true;
+        }
+
+        // worker thread
+        int flush() {
+            float tmp[256];
+            int n = 0;
+            while (int res = samples.pop(tmp, 256)) n += res;
+            return n;
+        }
+    };
+
+    Capture & getCapture() {
+        static Capture capture;
+        return capture;
+    }
+
     bool initAudio(SDL_AudioDeviceID & devid_in, SDL_AudioDeviceID & devid_out) {
         CG_INFO(0, "Initializing audio I/O ...\n");
 
@@ -114,6 +354,8 @@ namespace {
         captureSpec.freq = ::Data::Constants::kDefaultSamplingRate;
         captureSpec.format = AUDIO_F32SYS;
         captureSpec.samples = 1024;
+        captureSpec.callback = Capture::callback;
+        captureSpec.userdata = &::getCapture();
 
         devid_in = SDL_OpenAudioDevice(nullptr, SDL_TRUE, &captureSpec, &captureSpec, 0);
         if (!devid_in) {
@@ -151,6 +393,116 @@ extern "C" {
     int doInit() { return init(); }
 }
 
+// UI -> core commands - small enough to be stored inline in the input queue, the streams are passed by the id
+// of a slot of a preallocated pool and DataOn takes the latest parameters from a triple buffer
+struct Core::Command {
+    enum Type : std::uint8_t {
+        Init,
+        DataOn,
+        DataOff,
+        DataClear,
+        SendStream,
+        QueueStream,
+        SetReceiveSink,
+    };
+
+    struct InitArgs {
+        int sampleRate;
+        int samplesPerFrame;
+        int samplesPerSubFrame;
+        float hzPerFrame;
+    };
+
+    Type type = Init;
+    int slot = -1;
+    union {
+        InitArgs init;
+        int subFramesPerTx;
+    };
+};
+
+namespace {
+    // profile parameters of a DataOn command
+    struct DataOnArgs {
+        float freqStart_hz;
+        float freqDelta_hz;
+        float freqCheck_hz;
+        std::array<bool, ::Data::Constants::kMaxDataBits> dataBits;
+        int nDataBitsPerTx;
+        int nECCBytesPerTx;
+        int nBitsPerTone;
+        ::Data::StateInput::Modulation modulation;
+        int nCyclicPrefix;
+        int subFramesPerTx;
+        bool encodeIdParity;
+        bool useChecksum;
+        bool usePAPRReduction;
+        bool useRateAdaptation;
+        int rateStepId;
+        bool useInterleaving;
+        int nTxPerBlock;
+        int nParityTxPerBlock;
+        bool useFountain;
+        float fountainOverhead;
+        bool useInnerCode;
+        bool useFraming;
+        bool useArq;
+    };
+
+    // Reusable payload slots: the UI thread fills a slot and sends its id with the command, the core thread
+    // releases the slot once it is done with it. The ids go back to the UI thread through their own ring.
+    template <class T, int N>
+    struct PayloadPool {
+        PayloadPool() {
+            for (int i = 0; i < N; ++i) freeIds.push(i);
+        }
+
+        // UI thread
+        T * acquire(int & id) {
+            if (spareId >= 0) {
+                id = spareId;
+                spareId = -1;
+            } else if (freeIds.try_pop(id) == false) {
+                return nullptr;
+            }
+            return &slots[id];
+        }
+
+        // UI thread - the command carrying the slot was not sent
+        void cancel(int id) { spareId = id; }
+
+        // core thread
+        void release(int id) { freeIds.push(id); }
+
+        std::array<T, N> slots;
+        CG::SPSCRingBuffer<int, N> freeIds;
+        int spareId = -1;
+    };
+
+    // Snapshots for the UI, allocated on first use and reused once the pool holds the only reference.
+    // The references are in the active state, the three buffers of the triple buffer, the UI state and the copy
+    // that the UI holds while it renders - N > 6 always has a free one.
+    template <class T, int N>
+    struct SnapshotPool {
+        // worker thread - nullptr if every snapshot is still referenced
+        std::shared_ptr<T> acquire() {
+            for (auto & slot : slots) {
+                if (slot == nullptr) slot = std::make_shared<T>();
+                if (slot.use_count() == 1) {
+                    // the last reader is done with it
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    slot->version = ++version;
+                    return slot;
+                }
+            }
+            return nullptr;
+        }
+
+        int version = 0;
+        std::array<std::shared_ptr<T>, N> slots;
+    };
+}
+
 struct Core::Data {
     Data() {
         SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
@@ -181,6 +533,8 @@ struct Core::Data {
 
         int numChannels = 1;
 
+        ::getCapture().flush();
+
         SDL_PauseAudioDevice(devid_in, SDL_FALSE);
         SDL_PauseAudioDevice(devid_out, SDL_FALSE);
 
@@ -217,26 +571,791 @@ struct Core::Data {
         fftOut = 0;
     }
 
+    void startSending(Core::ByteSource && source, int nSubFramesPerTx) {
+        needRecache = true;
+
+        stateData[BUFFER_ACTIVE]->sendingData = true;
+        stateData[BUFFER_ACTIVE]->sendingDataBuffer = true;
+        stateData[BUFFER_ACTIVE]->nQueuedMessages = sendQueue.size();
+        stateData[BUFFER_ACTIVE]->nBytesSent = 0;
+        stateData[BUFFER_ACTIVE]->nRetransmissions = 0;
+
+        auto freqDeltaChecksum_hz = std::max(freqDelta_hz, 2*hzPerFrame);
+        for (int k = 0; k < ::Data::Constants::kMaxBitsPerChecksum; ++k) {
+            auto freq = freqCheck_hz + freqDeltaChecksum_hz*k;
+            checksumFreqs_hz[k] = freq;
+
+            float phaseOffset = ::getTonePhase(k, ::Data::Constants::kMaxBitsPerChecksum, usePAPRReduction);
+            for (int i = 0; i < samplesPerFrame; i++) {
+                checksumAmplitude[k][i] = std::sin((2.0*M_PI*i)*freq*isamplesPerFrame*ihzPerFrame + phaseOffset);
+            }
+            for (int i = 0; i < samplesPerFrame; i++) {
+                checksum0Amplitude[k][i] = std::sin((2.0*M_PI*i)*(freq + hzPerFrame)*isamplesPerFrame*ihzPerFrame + phaseOffset);
+            }
+        }
+
+        nTxSent = 0;
+        frameId = 0;
+        curTxSubFrameId = 0;
+        nRampFrames = nRampFramesBegin;
+        waitForNewFrame = true;
+
+        subFramesPerTx = nSubFramesPerTx;
+        sendSource = std::move(source);
+        txEndOfStream = false;
+        frameEncoder.startMessage();
+        arqSender.startMessage();
+
+        // DPSK needs one Tx with known phases before the first data Tx
+        sendPhaseReference = (modulation == ::Data::StateInput::Mod_DPSK);
+        txPhaseSign.fill(1.0f);
+
+        if (modulation == ::Data::StateInput::Mod_OFDM) {
+            buildOFDMPacket();
+        } else if (useInterleaving) {
+            buildBlock();
+        } else if (useFountain) {
+            buildFountainGeneration();
+        } else {
+            readChunk();
+        }
+    }
+
+    inline int getBytesPerTx() const { return nCodewordBytesPerTx - nECCBytesPerTx; }
+    // a fountain Tx carries its symbol header next to the chunk
+    inline int getChunkBytes() const { return getBytesPerTx() - (useFountain ? ::kFountainHeaderSize : 0); }
+
+    // fill the next Tx chunk from the current source: [size | end-of-stream flag][payload]
+    void readChunk() {
+        if (useArq) {
+            readArqFrame();
+            return;
+        }
+
+        if (useFraming) {
+            readFrame();
+            return;
+        }
+
+        int nPayload = getChunkBytes() - 1;
+
+        txChunk.fill(0);
+
+        // no room for payload next to the chunk header - end the stream right away
+        if (nPayload <= 0) txEndOfStream = true;
+
+        int n = 0;
+        while (n < nPayload && txEndOfStream == false) {
+            int res = sendSource ? sendSource(txChunk.data() + 1 + n, nPayload - n) : 0;
+            if (res <= 0) {
+                txEndOfStream = true;
+                break;
+            }
+            n += res;
+        }
+        txChunk[0] = n | (txEndOfStream ? ::kChunkEndOfStream : 0);
+
+        stateData[BUFFER_ACTIVE]->nBytesSent += n;
+        needRecache = true;
+    }
+
+    // framed chunk - the stream ends once the frame encoder has sent the length and CRC-32 trailer
+    void readFrame() {
+        txChunk.fill(0);
+
+        int n = frameEncoder.encode(sendSource, txChunk.data(), getChunkBytes());
+        txEndOfStream = frameEncoder.isMessageEnd();
+
+        stateData[BUFFER_ACTIVE]->nBytesSent += n;
+        needRecache = true;
+    }
+
+    // ARQ: missing and timed out frames first, new ones while the window has room, until all of them are acknowledged
+    // returns false when the current stream is done and there is nothing else queued
+    bool readArqFrame() {
+        txChunk.fill(0);
+
+        int n = 0;
+        int nRetransmissions = arqSender.getRetransmissions();
+        while (arqSender.next(frameEncoder, sendSource, txChunk.data(), getChunkBytes(), n) == false) {
+            if (arqSender.isFailed()) {
+                CG_WARN(0, "ARQ: a frame unacknowledged for %d Tx - dropping the rest of the message\n", ::kArqGiveUpTx);
+            }
+            txEndOfStream = true;
+            if (sendNextQueued() == false) return false;
+        }
+
+        stateData[BUFFER_ACTIVE]->nBytesSent += n;
+        stateData[BUFFER_ACTIVE]->nRetransmissions += arqSender.getRetransmissions() - nRetransmissions;
+        needRecache = true;
+
+        return true;
+    }
+
+    // returns false when the current stream has ended and there is nothing else queued
+    bool readNextChunk() {
+        if (useArq) return readArqFrame();
+
+        if (txEndOfStream && sendNextQueued() == false) return false;
+
+        readChunk();
+
+        return true;
+    }
+
+    inline int getDataTxPerBlock() const { return nTxPerBlock - nParityTxPerBlock; }
+
+    // read up to a block worth of chunks and compute the parity Tx - codeword b is made of byte b of every Tx
+    void buildBlock() {
+        int nBytesPerTx = nCodewordBytesPerTx;
+        int nDataTx = getDataTxPerBlock();
+
+        txBlock.assign(nTxPerBlock*nBytesPerTx, 0);
+        txBlockDataTx = 0;
+        while (txBlockDataTx < nDataTx) {
+            readChunk();
+            std::copy(txChunk.begin(), txChunk.begin() + nBytesPerTx, txBlock.begin() + txBlockDataTx*nBytesPerTx);
+            ++txBlockDataTx;
+
+            if (txEndOfStream) break;
+        }
+
+        std::vector<std::uint8_t> msgs(nBytesPerTx*nDataTx);
+        std::vector<std::uint8_t> codewords(nBytesPerTx*nTxPerBlock);
+        for (int b = 0; b < nBytesPerTx; ++b) {
+            for (int i = 0; i < nDataTx; ++i) msgs[b*nDataTx + i] = txBlock[i*nBytesPerTx + b];
+        }
+        if (::useBatchRS()) {
+            rsBlock->EncodeBatch(msgs.data(), codewords.data(), nBytesPerTx);
+        } else {
+            for (int b = 0; b < nBytesPerTx; ++b) {
+                rsBlock->Encode(msgs.data() + b*nDataTx, codewords.data() + b*nTxPerBlock);
+            }
+        }
+        for (int b = 0; b < nBytesPerTx; ++b) {
+            for (int i = nDataTx; i < nTxPerBlock; ++i) txBlock[i*nBytesPerTx + b] = codewords[b*nTxPerBlock + i];
+        }
+
+        txBlockTxId = 0;
+        ++txBlockId;
+    }
+
+    // the last block of a stream may be short - its unused data rows are zero and are not sent
+    inline int getTxBlockRow() const {
+        return (txBlockTxId < txBlockDataTx) ? txBlockTxId : getDataTxPerBlock() + (txBlockTxId - txBlockDataTx);
+    }
+
+    // returns false when the last block has been sent and there is nothing else queued
+    bool readNextBlockTx() {
+        if (++txBlockTxId < txBlockDataTx + nParityTxPerBlock) return true;
+        if (txEndOfStream && sendNextQueued() == false) return false;
+
+        buildBlock();
+
+        return true;
+    }
+
+    // read up to kMaxFountainSymbols chunks - a whole stream unless it is a long one
+    void buildFountainGeneration() {
+        int nChunkBytes = getChunkBytes();
+
+        std::vector<std::uint8_t> source;
+        int nSymbols = 0;
+        while (nSymbols < kMaxFountainSymbols) {
+            readChunk();
+            source.insert(source.end(), txChunk.begin(), txChunk.begin() + nChunkBytes);
+            ++nSymbols;
+
+            if (txEndOfStream) break;
+        }
+
+        fountainEncoder.init(source.data(), nSymbols, nChunkBytes);
+        txFountainSymbolId = 0;
+        txFountainMinSymbols = std::ceil(nSymbols*(1.0f + fountainOverhead));
+        txFountainGeneration = (txFountainGeneration + 1) % ::kFountainGenerations;
+    }
+
+    // a generation gives way to the rest of the stream or to the queued messages after its share of symbols,
+    // the last one is sent until Data Off
+    void readNextFountainTx() {
+        if (++txFountainSymbolId < txFountainMinSymbols) return;
+        if (txEndOfStream && sendNextQueued() == false) return;
+
+        buildFountainGeneration();
+    }
+
+    void encodeFountainTx(std::uint8_t * dst) {
+        int symbolId = txFountainSymbolId % ::kFountainSymbolIds;
+
+        txChunk.fill(0);
+        txChunk[0] = fountainEncoder.getNumSymbols();
+        txChunk[1] = (txFountainGeneration << 4) | (symbolId >> 8);
+        txChunk[2] = symbolId & 0xFF;
+        fountainEncoder.encode(symbolId, txChunk.data() + ::kFountainHeaderSize);
+
+        encodeChunk(dst);
+    }
+
+    void encodeChunk(std::uint8_t * dst) {
+        if (rs) {
+            rs->Encode(txChunk.data(), dst);
+        } else {
+            std::copy(txChunk.begin(), txChunk.begin() + nCodewordBytesPerTx, dst);
+        }
+    }
+
+    // OFDM packs up to kOFDMSymbolsPerPacket chunks in a packet - one RS codeword per data symbol
+    void buildOFDMPacket() {
+        int nBytesPerSymbol = nDataBitsPerTx/8;
+
+        std::vector<std::uint8_t> encoded;
+        encoded.reserve(::Data::Constants::kOFDMSymbolsPerPacket*nBytesPerSymbol);
+
+        int nSymbols = 0;
+        while (nSymbols < ::Data::Constants::kOFDMSymbolsPerPacket) {
+            readChunk();
+
+            encoded.resize((nSymbols + 1)*nBytesPerSymbol);
+            encodeChunk(encoded.data() + nSymbols*nBytesPerSymbol);
+            ++nSymbols;
+
+            if (txEndOfStream) break;
+        }
+
+        ofdm.encodePacket(encoded.data(), nSymbols, ofdmTxSamples);
+        ofdmTxPos = 0;
+    }
+
+    void receiveOFDMSymbol(int symbolId, int nSymbols, const std::uint8_t * symbol) {
+        std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> decoded;
+        if (rs) {
+            if (rs->Decode(symbol, decoded.data()) != 0) {
+                CG_WARN(0, "Failed to decode OFDM symbol %d / %d\n", symbolId + 1, nSymbols);
+                addLinkFailure();
+                return;
+            }
+            addLinkFrame(ofdm.getSNR_dB(), symbol, decoded.data());
+        } else {
+            std::copy(symbol, symbol + nDataBitsPerTx/8, decoded.begin());
+        }
+
+        // a long pause between packets means that the sender has given up on the previous stream
+        auto tNow = std::chrono::steady_clock::now();
+        if (symbolId == 0 && std::chrono::duration_cast<std::chrono::milliseconds>(tNow - tLastOFDMSymbol).count() > 500) {
+            rxEndOfStream = true;
+        }
+        tLastOFDMSymbol = tNow;
+
+        CG_WARN(0, "Receiving OFDM symbol %d / %d\n", symbolId + 1, nSymbols);
+
+        receiveChunk(decoded.data(), false);
+    }
+
+    // a Tx of an interleaved block - row is its position in the block, parity toggles from one block to the next
+    void receiveBlockTx(int row, int parity, const std::uint8_t * tx) {
+        if (row >= nTxPerBlock) return;
+        if (parity == rxBlockParity && row == rxBlockLastRow) return;
+
+        if (nRxBlockTx > 0 && (parity != rxBlockParity || row < rxBlockLastRow)) {
+            finishBlock();
+        }
+
+        int nBytesPerTx = nCodewordBytesPerTx;
+        if (nRxBlockTx == 0) {
+            rxBlock.assign(nTxPerBlock*nBytesPerTx, 0);
+            rxBlockHave.assign(nTxPerBlock, false);
+            rxBlockSNR_dB = 0.0f;
+        }
+        rxBlockParity = parity;
+        rxBlockLastRow = row;
+        tLastBlockTx = std::chrono::steady_clock::now();
+
+        if (rxBlockHave[row] == false) {
+            std::copy(tx, tx + nBytesPerTx, rxBlock.begin() + row*nBytesPerTx);
+            rxBlockHave[row] = true;
+            rxBlockSNR_dB += estimateSNR_dB();
+            ++nRxBlockTx;
+        }
+
+        CG_WARN(0, "Receiving block Tx %d / %d\n", row + 1, nTxPerBlock);
+
+        if (row == nTxPerBlock - 1) finishBlock();
+    }
+
+    // chunks in a decoded block: all of them non-empty except the one ending the stream, zero rows after it
+    int getBlockChunks(const std::uint8_t * block, int nRows, int nBytesPerTx) const {
+        for (int i = 0; i < nRows; ++i) {
+            std::uint8_t header = block[i*nBytesPerTx];
+            if ((header & ::kChunkSizeMask) > nBytesPerTx - 1) return -1;
+            if (header & ::kChunkEndOfStream) {
+                for (int j = (i + 1)*nBytesPerTx; j < nRows*nBytesPerTx; ++j) {
+                    if (block[j] != 0) return -1;
+                }
+                return i + 1;
+            }
+            if (header == 0) return -1;
+        }
+
+        return nRows;
+    }
+
+    // missing Tx are erasures - except that the data rows after the end of a short block were never sent and are zero
+    void finishBlock() {
+        int nBytesPerTx = nCodewordBytesPerTx;
+        int nDataTx = getDataTxPerBlock();
+        int nReceived = nRxBlockTx;
+        nRxBlockTx = 0;
+
+        if (nReceived == 0) return;
+
+        // a block has at least one data Tx and ends somewhere after the last data Tx received
+        int endMin = 1;
+        for (int i = 0; i < nDataTx; ++i) {
+            if (rxBlockHave[i]) endMin = i + 1;
+        }
+
+        auto getErasures = [&](int end, std::vector<std::uint8_t> & erasures) {
+            erasures.clear();
+            for (int i = 0; i < nTxPerBlock; ++i) {
+                if (rxBlockHave[i] == false && (i < end || i >= nDataTx)) erasures.push_back(i);
+            }
+        };
+
+        // the longest block the parity can recover, then the shortest one
+        std::vector<std::uint8_t> erasures;
+        int endMax = nDataTx;
+        for (getErasures(endMax, erasures); endMax > endMin && (int) erasures.size() > nParityTxPerBlock; getErasures(--endMax, erasures)) {}
+
+        std::vector<std::uint8_t> codewords(nBytesPerTx*nTxPerBlock);
+        std::vector<std::uint8_t> decoded(nBytesPerTx*nDataTx);
+        std::vector<std::uint8_t> block(nDataTx*nBytesPerTx);
+        for (int b = 0; b < nBytesPerTx; ++b) {
+            for (int i = 0; i < nTxPerBlock; ++i) codewords[b*nTxPerBlock + i] = rxBlock[i*nBytesPerTx + b];
+        }
+
+        for (int end : { endMax, endMin }) {
+            getErasures(end, erasures);
+            if ((int) erasures.size() > nParityTxPerBlock) break;
+
+            // with erasures every codeword goes through the single codeword decoder anyway
+            bool ok = true;
+            if (erasures.empty() && ::useBatchRS()) {
+                ok = rsBlock->DecodeBatch(codewords.data(), decoded.data(), nBytesPerTx) == 0;
+            } else {
+                for (int b = 0; ok && b < nBytesPerTx; ++b) {
+                    ok = rsBlock->Decode(codewords.data() + b*nTxPerBlock, decoded.data() + b*nDataTx, erasures.data(), erasures.size()) == 0;
+                }
+            }
+            int nCorrectedMax = 0;
+            for (int b = 0; ok && b < nBytesPerTx; ++b) {
+                int nCorrected = 0;
+                for (int i = 0; i < nDataTx; ++i) {
+                    std::uint8_t x = decoded[b*nDataTx + i];
+                    if (rxBlockHave[i] && x != codewords[b*nTxPerBlock + i]) ++nCorrected;
+                    block[i*nBytesPerTx + b] = x;
+                }
+                nCorrectedMax = std::max(nCorrectedMax, nCorrected);
+            }
+
+            int nChunks = ok ? getBlockChunks(block.data(), nDataTx, nBytesPerTx) : -1;
+            if (nChunks < 0) {
+                if (end == endMin) break;
+                continue;
+            }
+
+            addLinkFrame(rxBlockSNR_dB/nReceived, ((float) (erasures.size() + 2*nCorrectedMax))/nParityTxPerBlock);
+            for (int i = 0; i < nChunks; ++i) {
+                receiveChunk(block.data() + i*nBytesPerTx, false);
+            }
+            return;
+        }
+
+        CG_WARN(0, "Failed to decode block - %d / %d Tx received\n", nReceived, nTxPerBlock);
+        addLinkFailure();
+        rxEndOfStream = true;
+    }
+
+    // an encoded symbol of a broadcast generation - its chunks are passed on as soon as the generation decodes
+    void receiveFountainTx(const std::uint8_t * tx) {
+        int nSymbols = tx[0];
+        int generation = tx[1] >> 4;
+        int symbolId = ((tx[1] & 0x0F) << 8) | tx[2];
+        int nChunkBytes = getChunkBytes();
+
+        if (nSymbols == 0) return;
+
+        if (generation != rxFountainGeneration || nSymbols != fountainDecoder.getNumSymbols()) {
+            if (fountainDecoder.getNumReceived() > 0 && fountainDecoder.isComplete() == false) {
+                CG_WARN(0, "Fountain generation lost - %d / %d source symbols known\n", fountainDecoder.getNumKnown(), fountainDecoder.getNumSymbols());
+                addLinkFailure();
+                rxEndOfStream = true;
+            }
+
+            // a stream continues in the next generation - anything else starts over
+            if (generation != (rxFountainGeneration + 1) % ::kFountainGenerations) rxEndOfStream = true;
+
+            fountainDecoder.init(nSymbols, nChunkBytes);
+            rxFountainGeneration = generation;
+        }
+
+        if (fountainDecoder.isComplete()) return;
+
+        if (fountainDecoder.add(symbolId, tx + ::kFountainHeaderSize) == false) {
+            CG_WARN(0, "Receiving fountain symbol %d - %d / %d source symbols known\n", symbolId, fountainDecoder.getNumKnown(), nSymbols);
+            return;
+        }
+
+        int nChunks = getBlockChunks(fountainDecoder.getSource(), nSymbols, nChunkBytes);
+        if (nChunks < 0) {
+            CG_WARN(0, "Invalid fountain generation - %d source symbols\n", nSymbols);
+            addLinkFailure();
+            rxEndOfStream = true;
+            return;
+        }
+
+        CG_WARN(0, "Decoded fountain generation - %d source symbols from %d received\n", nSymbols, fountainDecoder.getNumReceived());
+        for (int i = 0; i < nChunks; ++i) {
+            receiveChunk(fountainDecoder.getSource() + i*nChunkBytes, false);
+        }
+    }
+
+    // long enough for all the parity Tx of a block to be lost
+    float getBlockTimeout_ms() const {
+        return 1000.0f*(nParityTxPerBlock + 2)*std::max(1, nSubFramesPerRx)*samplesPerSubFrame/sampleRate;
+    }
+
+    // repeated chunks replace the previous one in the display, but are not passed to the sink again
+    void receiveChunk(const std::uint8_t * chunk, bool isRepeat) {
+        int n = std::min(chunk[0] & ::kChunkSizeMask, getChunkBytes() - 1);
+        bool isEnd = (chunk[0] & ::kChunkEndOfStream) != 0;
+
+        // a repeat is decoded again from the state before the chunk it replaces
+        if (isRepeat) {
+            receivedId = lastChunkStart;
+            rxStream = rxStreamLast;
+        } else if (rxEndOfStream) {
+            receivedId = 0;
+            receivedData.fill(0);
+            stateData[BUFFER_ACTIVE]->nBytesReceived = 0;
+            rxStream = StreamDecoder();
+        }
+        rxStreamLast = rxStream;
+        lastChunkStart = receivedId;
+
+        rxDecoded.clear();
+        rxStream.decode(chunk + 1, n, rxDecoded);
+        n = rxDecoded.size();
+
+        if (rxStream.rateReport >= 0) {
+            if (useRateAdaptation) pendingRateStepId = rxStream.rateReport;
+            rxStream.rateReport = -1;
+        }
+        tLastReceived = std::chrono::steady_clock::now();
+
+        if (isRepeat == false) {
+            if (receiveSink) {
+                receiveSink(rxDecoded.data(), n, isEnd);
+            }
+            stateData[BUFFER_ACTIVE]->nBytesReceived += n;
+        }
+
+        // the display keeps only the tail of long streams - messages queued back to back never end the stream
+        for (int i = 0; i < n; ++i) {
+            if (receivedId >= (int) receivedData.size() - 1) {
+                int nDrop = receivedData.size()/2;
+                std::copy(receivedData.begin() + nDrop, receivedData.begin() + receivedId, receivedData.begin());
+                receivedId -= nDrop;
+                lastChunkStart = std::max(0, lastChunkStart - nDrop);
+                std::fill(receivedData.begin() + receivedId, receivedData.end(), 0);
+            }
+            receivedData[receivedId++] = (rxDecoded[i] == 0) ? ' ' : rxDecoded[i];
+        }
+
+        rxEndOfStream = isEnd;
+        needReceivedSnapshot = true;
+        needRecache = true;
+    }
+
+    // message bytes of a framed chunk go on as a plain chunk, the trailer tells if the whole message is intact
+    void receiveFrame(const std::uint8_t * frame) {
+        rxFrameBytes.clear();
+        auto info = frameDecoder.add(frame, getChunkBytes(), rxFrameBytes);
+        if (info.isRepeat) return;
+
+        if (info.isLost) {
+            CG_WARN(0, "Frames lost - dropping the rest of the message\n");
+            ++stateData[BUFFER_ACTIVE]->nMessagesCorrupted;
+            needRecache = true;
+        }
+        if (info.isAccepted == false) return;
+        if (info.isStart) rxEndOfStream = true;
+
+        if (rxFrameBytes.size() > 0 || info.isEnd) {
+            std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> chunk;
+            chunk[0] = rxFrameBytes.size() | (info.isEnd ? ::kChunkEndOfStream : 0);
+            std::copy(rxFrameBytes.begin(), rxFrameBytes.end(), chunk.begin() + 1);
+            receiveChunk(chunk.data(), false);
+        }
+
+        if (info.isEnd) {
+            if (info.isValid) {
+                CG_INFO(0, "Received message: %d bytes, CRC-32 OK\n", frameDecoder.getMessageLength());
+                ++stateData[BUFFER_ACTIVE]->nMessagesReceived;
+            } else {
+                CG_WARN(0, "Received message: %d bytes, length / CRC-32 mismatch\n", frameDecoder.getMessageLength());
+                ++stateData[BUFFER_ACTIVE]->nMessagesCorrupted;
+            }
+            needRecache = true;
+        }
+    }
+
+    // ARQ: frames go on to the frame decoder in sequence order - retransmissions fill the gaps
+    void receiveArqFrame(const std::uint8_t * frame) {
+        tLastArqFrame = std::chrono::steady_clock::now();
+        if (arqReceiver.add(frame, getChunkBytes()) == false) return;
+
+        while (arqReceiver.next(rxArqFrame)) {
+            receiveFrame(rxArqFrame.data());
+        }
+    }
+
+    // first bin of the acknowledgement band - right above the highest data and checksum tones
+    int getAckBin() const {
+        int nTones = (nBitsPerTone > 1) ? nDataBitsPerTx/nBitsPerTone : nDataBitsPerTx;
+        int dataTop = std::round((freqStart_hz + freqDelta_hz*(nTones - 1))*ihzPerFrame) + (1 << nBitsPerTone);
+
+        auto freqDeltaChecksum_hz = std::max(freqDelta_hz, 2*hzPerFrame);
+        int checksumTop = std::round((freqCheck_hz + freqDeltaChecksum_hz*(::Data::Constants::kMaxBitsPerChecksum - 1))*ihzPerFrame) + 2;
+
+        return std::max(dataTop, checksumTop) + 4;
+    }
+
+    inline bool isSendingAck() const {
+        return useArq && arqReceiver.isSynced() &&
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tLastArqFrame).count() < ::kArqAckHold_ms;
+    }
+
+    // the acknowledgement word with one of two tones per bit, on top of whatever is being sent
+    void addAckTones(int sampleStartId, int sampleFinalId) {
+        auto word = arqReceiver.getAck();
+        float amplitude = sendVolume/::kArqAckBits;
+        for (int k = 0; k < ::kArqAckBits; ++k) {
+            int bin = ackBin + 2*k + (((word >> k) & 1) ? 0 : 1);
+            int phase = (k*k*samplesPerFrame)/(2*::kArqAckBits);
+            for (int i = sampleStartId; i < sampleFinalId; ++i) {
+                outputBlock[i] += amplitude*ackSinTable[(bin*i + phase) % samplesPerFrame];
+            }
+        }
+    }
+
+    // a word from the acknowledgement band counts once it is the same in two consecutive frames
+    void receiveAck() {
+        std::uint32_t word = 0;
+        for (int k = 0; k < ::kArqAckBits; ++k) {
+            int bin = ackBin + 2*k;
+            float a1 = historySpectrumAverage[bin];
+            float a0 = historySpectrumAverage[bin + 1];
+            if (a1 < 3*a0 && a0 < 3*a1) {
+                // no clear tone - nobody is acknowledging
+                lastAckWord = 0;
+                return;
+            }
+            if (a1 > a0) word |= 1u << k;
+        }
+
+        int base = 0;
+        int bitmap = 0;
+        if (word == lastAckWord && ::decodeAck(word, base, bitmap)) {
+            arqSender.onAck(base, bitmap);
+        }
+        lastAckWord = word;
+    }
+
+    // power in the bins carrying the received values relative to the bins of the opposite values
+    float estimateSNR_dB() const {
+        constexpr float kEps = 1e-12f;
+
+        double sum = 0.0;
+        int n = 0;
+        if (modulation == ::Data::StateInput::Mod_DPSK) {
+            int nHistory = rxPhaseHistory.size();
+            if (nHistory == 0) return 0.0f;
+            const auto & cur = rxPhaseHistory[(rxPhaseHistoryId + nHistory - 1) % nHistory];
+            const auto & prev = rxPhaseHistory[rxPhaseHistoryId];
+            for (int k = 0; k < nDataBitsPerTx; ++k) {
+                auto z = cur[k]*std::conj(prev[k]);
+                sum += 10.0*std::log10((z.real()*z.real() + kEps)/(z.imag()*z.imag() + kEps));
+                ++n;
+            }
+        } else if (nBitsPerTone == 1) {
+            for (int k = 0; k < nDataBitsPerTx; ++k) {
+                int bin = std::round(dataFreqs_hz[k]*ihzPerFrame);
+                float a = historySpectrumAverage[bin];
+                float b = historySpectrumAverage[bin + 1];
+                sum += 10.0*std::log10((std::max(a, b) + kEps)/(std::min(a, b) + kEps));
+                ++n;
+            }
+        } else {
+            int nTonesPerGroup = 1 << nBitsPerTone;
+            int nGroups = nDataBitsPerTx/nBitsPerTone;
+            for (int g = 0; g < nGroups; ++g) {
+                int bin = std::round(dataFreqs_hz[g]*ihzPerFrame);
+                float vMax = 0.0f;
+                float vSum = 0.0f;
+                for (int m = 0; m < nTonesPerGroup; ++m) {
+                    vMax = std::max(vMax, historySpectrumAverage[bin + m]);
+                    vSum += historySpectrumAverage[bin + m];
+                }
+                sum += 10.0*std::log10((vMax + kEps)/((vSum - vMax)/(nTonesPerGroup - 1) + kEps));
+                ++n;
+            }
+        }
+
+        return (n > 0) ? sum/n : 0.0f;
+    }
+
+    // a decoded frame - the bytes changed by the RS decoder tell how much of its margin is left
+    void addLinkFrame(float snr_dB, const std::uint8_t * received, const std::uint8_t * repaired) {
+        int nCorrected = 0;
+        for (int i = 0; i < nCodewordBytesPerTx - nECCBytesPerTx; ++i) {
+            if (received[i] != repaired[i]) ++nCorrected;
+        }
+        float eccUsage = (nECCBytesPerTx > 1) ? ((float) nCorrected)/(nECCBytesPerTx/2) : 0.0f;
+
+        addLinkFrame(snr_dB, eccUsage);
+    }
+
+    void addLinkFrame(float snr_dB, float eccUsage) {
+        rateControl.addFrame(snr_dB, eccUsage);
+        rateControl.getLinkQuality(rateStepId, stateData[BUFFER_ACTIVE]->linkQuality);
+        needRecache = true;
+    }
+
+    void addLinkFailure() {
+        rateControl.addFailure();
+        rateControl.getLinkQuality(rateStepId, stateData[BUFFER_ACTIVE]->linkQuality);
+        needRecache = true;
+    }
+
+    // called when the first chunk of an outgoing stream is read - asks the peer to move to the recommended step
+    std::uint8_t getRateReport() {
+        if (useRateAdaptation == false || rateStepId < 0) return 0;
+
+        int stepId = rateControl.getRecommendedStep(rateStepId);
+        if (stepId == rateStepId) return 0;
+
+        pendingRateStepId = stepId;
+
+        return (stepId + 1) << ::kStreamRateShift;
+    }
+
+    void setRateStep(int stepId) {
+        CG_INFO(0, "Switching to '%s'\n", ::Data::StateInput::configNames[::Data::StateInput::rateLadder[stepId].configId]);
+
+        pendingRateStepId = -1;
+        rateControl.reset();
+
+        stateData[BUFFER_ACTIVE]->rateStepId = stepId;
+        ++stateData[BUFFER_ACTIVE]->nRateChanges;
+        rateControl.getLinkQuality(stepId, stateData[BUFFER_ACTIVE]->linkQuality);
+        needRecache = true;
+    }
+
+    // continue with the next queued stream without ramping down
+    bool sendNextQueued() {
+        if (sendQueue.empty()) return false;
+
+        sendSource = std::move(sendQueue.front());
+        sendQueue.pop_front();
+        txEndOfStream = false;
+        frameEncoder.startMessage();
+        arqSender.startMessage();
+
+        needRecache = true;
+        stateData[BUFFER_ACTIVE]->nQueuedMessages = sendQueue.size();
+
+        return true;
+    }
+
+    const RampEnvelope & getRampEnvelope(int nFrames) {
+        auto & ramp = rampEnvelopes[nFrames];
+        if ((int) ramp.up.size() != nFrames*samplesPerSubFrame) {
+            ::buildRampEnvelope(nFrames, samplesPerSubFrame, rampShape, ramp);
+        }
+        return ramp;
+    }
+
     enum BufferId {
         BUFFER_UI,
-        BUFFER_CACHED,
         BUFFER_ACTIVE,
     };
 
-    std::thread workerMain;
+    std::thread workerMain;
+
+    bool needRecache = false;
+    bool encodeIdParity = true;
+    bool useChecksum = false;
+    bool usePAPRReduction = false;
+    std::atomic<bool> isRunning;
+
+    std::weak_ptr<::Data::StateInput> stateInput;
+    std::array<std::shared_ptr<::Data::StateData>, 2> stateData;
+
+    // snapshots of the active state published by workerMain, taken by the UI thread in update()
+    CG::TripleBuffer<::Data::StateData> stateSnapshots;
+
+    SnapshotPool<::Data::FrameSnapshot, 8> frameSnapshots;
+    SnapshotPool<::Data::ToneSnapshot, 8> toneSnapshots;
+    SnapshotPool<::Data::ReceivedSnapshot, 8> receivedSnapshots;
+    bool needToneSnapshot = false;
+    bool needReceivedSnapshot = false;
+
+    // waveform and spectra of the frame that has just been analyzed
+    void publishFrame() {
+        auto snapshot = frameSnapshots.acquire();
+        if (snapshot == nullptr) return;
+
+        std::copy(sampleAmplitude.begin(), sampleAmplitude.begin() + samplesPerFrame, snapshot->sampleAmplitude.begin());
+        std::copy(sampleSpectrum.begin(), sampleSpectrum.begin() + samplesPerFrame, snapshot->sampleSpectrum.begin());
+        std::copy(historySpectrumAverage.begin(), historySpectrumAverage.begin() + samplesPerFrame, snapshot->historySpectrumAverage.begin());
 
-    bool needRecache = false;
-    bool cacheUpdated = false;
-    bool encodeIdParity = true;
-    bool useChecksum = false;
-    std::atomic<bool> isRunning;
+        stateData[BUFFER_ACTIVE]->frame = std::move(snapshot);
+        needRecache = true;
+    }
+
+    // tone waveforms and received text - only when they have changed
+    void publishPending() {
+        if (needToneSnapshot) {
+            if (auto snapshot = toneSnapshots.acquire()) {
+                snapshot->bitAmplitude = bitAmplitude;
+                stateData[BUFFER_ACTIVE]->tones = std::move(snapshot);
+                needToneSnapshot = false;
+            }
+        }
+
+        if (needReceivedSnapshot) {
+            if (auto snapshot = receivedSnapshots.acquire()) {
+                snapshot->receivedData = receivedData;
+                stateData[BUFFER_ACTIVE]->received = std::move(snapshot);
+                needReceivedSnapshot = false;
+            }
+        }
+    }
 
-    mutable std::mutex mutexStateData;
+    // commands are pushed only by the UI thread and run only by workerMain
+    CG::SPSCRingBuffer<Command, 256> inputQueue;
+    // DataOn is idempotent - however many are pending, each one runs with the most recent parameters
+    CG::TripleBuffer<DataOnArgs> dataOnArgs;
+    PayloadPool<Core::ByteSource, 16> sources;
+    PayloadPool<Core::ByteSink, 2> sinks;
 
-    std::weak_ptr<::Data::StateInput> stateInput;
-    std::array<std::shared_ptr<::Data::StateData>, 3> stateData;
+    // UI thread
+    bool pushCommand(const Command & command) {
+        if (inputQueue.push(command)) return true;
 
-    CG::RingBuffer<std::function<void()>, 256> inputQueue;
+        CG_WARN(0, "Input queue is full - dropping command %d\n", (int) command.type);
+        return false;
+    }
 
     // App-specific data
     bool isInitialized = false;
@@ -254,6 +1373,7 @@ struct Core::Data {
     ::Data::AmplitudeData outputBlockTmp;
     std::array<::Data::AmplitudeData, ::Data::Constants::kMaxDataBits> bitAmplitude;
     std::array<::Data::AmplitudeData, ::Data::Constants::kMaxDataBits> bit0Amplitude;
+    std::vector<::Data::AmplitudeData> toneAmplitude;
     std::array<::Data::AmplitudeData, ::Data::Constants::kMaxBitsPerChecksum> checksumAmplitude;
     std::array<::Data::AmplitudeData, ::Data::Constants::kMaxBitsPerChecksum> checksum0Amplitude;
 
@@ -273,9 +1393,12 @@ struct Core::Data {
 
     int frameId = 0;
     int nRampFrames = 0;
+    int nRampFramesUp = 0;
     int nRampFramesBegin = 0;
     int nRampFramesEnd = 0;
     int nRampFramesBlend = 0;
+    ::Data::StateInput::RampShape rampShape = ::Data::StateInput::Ramp_Linear;
+    std::map<int, RampEnvelope> rampEnvelopes;
     int dataId = 0;
     bool waitForNewFrame = false;
     std::array<bool, ::Data::Constants::kMaxDataBits> dataBits;
@@ -286,24 +1409,110 @@ struct Core::Data {
     ::Data::SpectrumData historySpectrumAverage;
     std::array<::Data::SpectrumData, ::Data::Constants::kMaxSpectrumHistory> historySpectrum;
 
-    int sendId = 0;
+    int nTxSent = 0;
     int receivedId = 0;
     int nConfirmFrames = 0;
     int subFramesPerTx;
     int curTxSubFrameId = 0;
     int nDataBitsPerTx = 0;
     int nECCBytesPerTx = 0;
-    std::array<char, ::Data::Constants::kMaxDataSize> sendData;
+    // bytes of the RS codeword in every Tx - fewer than nDataBitsPerTx/8 under the inner code
+    int nCodewordBytesPerTx = 0;
+    int nBitsPerTone = 1;
+    ::Data::StateInput::Modulation modulation = ::Data::StateInput::Mod_FSK;
+
+    // DPSK state: per-tone sign of the transmitted carrier and history of received bins
+    bool sendPhaseReference = false;
+    std::array<float, ::Data::Constants::kMaxDataBits> txPhaseSign;
+    int rxPhaseHistoryId = 0;
+    std::vector<std::array<std::complex<float>, ::Data::Constants::kMaxDataBits>> rxPhaseHistory;
+
+    // OFDM state: precomputed packet samples and the packet receiver
+    int nCyclicPrefix = 0;
+    int ofdmTxPos = 0;
+    std::vector<float> ofdmTxSamples;
+    std::chrono::steady_clock::time_point tLastOFDMSymbol;
+    OFDM ofdm;
+
+    Core::ByteSource sendSource;
+    std::deque<Core::ByteSource> sendQueue;
+    std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> txChunk;
+    bool txEndOfStream = true;
+
+    // rate adaptation: the current ladder step and the one agreed with the peer, applied once the link is quiet
+    bool useRateAdaptation = false;
+    int rateStepId = -1;
+    int pendingRateStepId = -1;
+    int nFramesNotDecoded = 0;
+    int nSubFramesPerRx = 0;
+    std::chrono::steady_clock::time_point tLastReceived;
+    RateControl rateControl;
+
+    // interleaving: a lost Tx costs every codeword of its block a single erasure
+    bool useInterleaving = false;
+    int nTxPerBlock = 0;
+    int nParityTxPerBlock = 0;
+    std::shared_ptr<RS::Codec> rsBlock = nullptr;
+
+    int txBlockId = 0;
+    int txBlockTxId = 0;
+    int txBlockDataTx = 0;
+    std::vector<std::uint8_t> txBlock;
+
+    int nRxBlockTx = 0;
+    int rxBlockParity = -1;
+    int rxBlockLastRow = -1;
+    float rxBlockSNR_dB = 0.0f;
+    std::vector<bool> rxBlockHave;
+    std::vector<std::uint8_t> rxBlock;
+    std::chrono::steady_clock::time_point tLastBlockTx;
+
+    // fountain broadcast: a generation of chunks is sent as a run of encoded symbols, a few more than K of them decode it
+    bool useFountain = false;
+    float fountainOverhead = 0.0f;
+    int txFountainGeneration = 0;
+    int txFountainSymbolId = 0;
+    int txFountainMinSymbols = 0;
+    FountainEncoder fountainEncoder;
+
+    int rxFountainGeneration = -1;
+    FountainDecoder fountainDecoder;
+
+    Core::ByteSink receiveSink;
+    StreamDecoder rxStream;
+    StreamDecoder rxStreamLast;
+    std::vector<std::uint8_t> rxDecoded;
+    bool rxEndOfStream = true;
+    int lastChunkStart = 0;
     std::array<char, ::Data::Constants::kMaxDataSize> receivedData;
 
-    std::shared_ptr<RS::ReedSolomon> rs = nullptr;
+    std::shared_ptr<RS::Codec> rs = nullptr;
+
+    // convolutional inner code under the RS code of every Tx - soft decisions from the detector margins
+    bool useInnerCode = false;
+    ConvolutionalCode innerCode;
+
+    // framing: sequence numbers tell new chunks from repeats, a length / CRC-32 trailer ends every message
+    bool useFraming = false;
+    FrameEncoder frameEncoder;
+    FrameDecoder frameDecoder;
+    std::vector<std::uint8_t> rxFrameBytes;
+
+    // selective-repeat ARQ: the receiver acknowledges on its own band above the data and checksum tones
+    bool useArq = false;
+    ArqSender arqSender;
+    ArqReceiver arqReceiver;
+    std::vector<std::uint8_t> rxArqFrame;
+    std::chrono::steady_clock::time_point tLastArqFrame;
+    int ackBin = 0;
+    std::vector<float> ackSinTable;
+    std::uint32_t lastAckWord = 0;
 };
 
 Core::Core() : _data(new Data()) {
     CG_INFO(0, "Creating Core object\n");
 
     _data->stateData[Data::BUFFER_UI]     = std::make_shared<::Data::StateData>();
-    _data->stateData[Data::BUFFER_CACHED] = std::make_shared<::Data::StateData>();
     _data->stateData[Data::BUFFER_ACTIVE] = std::make_shared<::Data::StateData>();
 
     g_init = [this]() {
@@ -325,16 +1534,12 @@ void Core::init() {
 }
 
 void Core::update() {
-    if (_data->cacheUpdated == false) return;
-
-    std::lock_guard<std::mutex> lock(_data->mutexStateData);
+    if (_data->stateSnapshots.update() == false) return;
 
-    auto & bsrc = _data->stateData[Data::BUFFER_CACHED];
+    const auto & bsrc = _data->stateSnapshots.getReadBuffer();
     auto & bdst = _data->stateData[Data::BUFFER_UI];
 
-    ::updateStateData(bsrc.get(), bdst.get());
-
-    _data->cacheUpdated = false;
+    ::updateStateData(&bsrc, bdst.get());
 }
 
 void Core::terminate() {
@@ -357,181 +1562,481 @@ void Core::addEvent(Event event) {
     switch(event) {
         case Init:
             {
-                auto sampleRate = inp->sampleRate;
-                auto samplesPerFrame = inp->samplesPerFrame;
-                auto samplesPerSubFrame = inp->samplesPerSubFrame;
-                auto hzPerFrame = inp->getHzPerFrame();
+                Command command;
+                command.type = Command::Init;
+                command.init.sampleRate = inp->sampleRate;
+                command.init.samplesPerFrame = inp->samplesPerFrame;
+                command.init.samplesPerSubFrame = inp->samplesPerSubFrame;
+                command.init.hzPerFrame = inp->getHzPerFrame();
+
+                _data->pushCommand(command);
+                break;
+            }
+        case DataOn:
+            {
+                auto args = &_data->dataOnArgs.getWriteBuffer();
+                args->freqStart_hz = inp->freqStart_hz;
+                args->freqDelta_hz = inp->freqDelta_hz;
+                args->freqCheck_hz = inp->freqCheck_hz;
+                args->dataBits = inp->dataBits;
+                args->nDataBitsPerTx = inp->nDataBitsPerTx;
+                args->nECCBytesPerTx = inp->nECCBytesPerTx;
+                args->nBitsPerTone = inp->nBitsPerTone;
+                args->modulation = inp->modulation;
+                args->nCyclicPrefix = inp->nCyclicPrefix;
+                args->subFramesPerTx = inp->subFramesPerTx;
+                args->encodeIdParity = inp->encodeIdParity;
+                args->useChecksum = inp->useChecksum;
+                args->usePAPRReduction = inp->usePAPRReduction;
+                args->useRateAdaptation = inp->useRateAdaptation;
+                args->rateStepId = ::Data::StateInput::getRateStepId(inp->configId);
+                args->useInterleaving = inp->useInterleaving;
+                args->nTxPerBlock = inp->nTxPerBlock;
+                args->nParityTxPerBlock = inp->nParityTxPerBlock;
+                args->useFountain = inp->useFountain;
+                args->fountainOverhead = inp->fountainOverhead;
+                args->useInnerCode = inp->useInnerCode;
+                args->useFraming = inp->useFraming;
+                args->useArq = inp->useArq;
+                _data->dataOnArgs.publish();
+
+                Command command;
+                command.type = Command::DataOn;
+                _data->pushCommand(command);
+                break;
+            }
+        case DataOff:
+            {
+                CG_INFO(0, "Data OFF\n");
 
-                _data->inputQueue.push([this, sampleRate, samplesPerFrame, samplesPerSubFrame, hzPerFrame]() {
-                    if (_data->isInitialized) return;
+                Command command;
+                command.type = Command::DataOff;
 
-                    _data->isInitialized = false;
-                    _data->needRecache = true;
+                _data->pushCommand(command);
+                break;
+            }
+        case DataSend:
+            {
+                CG_INFO(0, "Data Send, size = %d\n", (int) strlen(inp->sendData.data()));
 
-                    _data->stateData[Data::BUFFER_ACTIVE]->sampleAmplitude = nullptr;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sampleSpectrum = nullptr;
-                    _data->stateData[Data::BUFFER_ACTIVE]->historySpectrumAverage = nullptr;
-                    _data->stateData[Data::BUFFER_ACTIVE]->bitAmplitude = nullptr;
-                    _data->stateData[Data::BUFFER_ACTIVE]->receivedData = nullptr;
-
-                    _data->sampleRate = sampleRate;
-                    _data->samplesPerFrame = samplesPerFrame;
-                    _data->samplesPerSubFrame = samplesPerSubFrame;
-                    _data->isamplesPerFrame = 1.0f/samplesPerFrame;
-                    _data->hzPerFrame = hzPerFrame;
-                    _data->ihzPerFrame = 1.0f/hzPerFrame;
-
-                    _data->free();
-                    if (_data->init() == false) return;
-
-                    CG_INFO(0, "Hz per frame = %4.4f\n", _data->hzPerFrame);
-
-                    _data->isInitialized = true;
-                    _data->stateData[Data::BUFFER_ACTIVE]->samplesPerFrame = _data->samplesPerFrame;
-                    _data->stateData[Data::BUFFER_ACTIVE]->samplesPerSubFrame = _data->samplesPerSubFrame;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sampleAmplitude = &_data->sampleAmplitude;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sampleSpectrum = &_data->sampleSpectrum;
-                    _data->stateData[Data::BUFFER_ACTIVE]->historySpectrumAverage = &_data->historySpectrumAverage;
-                    _data->stateData[Data::BUFFER_ACTIVE]->bitAmplitude = &_data->bitAmplitude;
-                    _data->stateData[Data::BUFFER_ACTIVE]->receivedData = &_data->receivedData;
-                });
+                sendStream(::makeTextSource(inp->sendData));
                 break;
             }
-        case DataOn:
+        case DataQueue:
             {
-                auto freqStart_hz = inp->freqStart_hz;
-                auto freqDelta_hz = inp->freqDelta_hz;
-                auto freqCheck_hz = inp->freqCheck_hz;
-                auto dataBits = inp->dataBits;
-                auto nDataBitsPerTx = inp->nDataBitsPerTx;
-                auto nECCBytesPerTx = inp->nECCBytesPerTx;
-                auto encodeIdParity = inp->encodeIdParity;
-                auto useChecksum = inp->useChecksum;
-
-                _data->inputQueue.push([this, freqStart_hz, freqDelta_hz, freqCheck_hz, dataBits, nDataBitsPerTx,
-                                       nECCBytesPerTx, encodeIdParity, useChecksum]() {
-                    _data->needRecache = true;
+                CG_INFO(0, "Data Queue, size = %d\n", (int) strlen(inp->sendData.data()));
 
-                    _data->freqStart_hz = freqStart_hz;
-                    _data->freqDelta_hz = freqDelta_hz;
-                    _data->freqCheck_hz = freqCheck_hz;
-                    _data->encodeIdParity = encodeIdParity;
-                    _data->useChecksum = useChecksum;
+                queueStream(::makeTextSource(inp->sendData));
+                break;
+            }
+        case DataLinkReport:
+            {
+                CG_INFO(0, "Data Link Report\n");
 
-                    _data->dataBits = dataBits;
-                    _data->nDataBitsPerTx = nDataBitsPerTx;
-                    _data->nECCBytesPerTx = nECCBytesPerTx;
+                // an empty stream - only its header with the rate report is sent
+                sendStream([](std::uint8_t * , int ) { return 0; });
+                break;
+            }
+        case DataClear:
+            {
+                CG_INFO(0, "Data Clear\n");
 
-                    if (nDataBitsPerTx/8 > nECCBytesPerTx && nECCBytesPerTx > 0) {
-                        _data->rs = std::make_shared<RS::ReedSolomon>(nDataBitsPerTx/8 - nECCBytesPerTx, nECCBytesPerTx);
-                    } else {
-                        CG_WARN(0, "Not using ECC because the specified number of ECC bytes is too big for this protocol\n");
-                        _data->rs.reset();
-                        _data->nECCBytesPerTx = 0;
-                    }
+                Command command;
+                command.type = Command::DataClear;
 
-                    for (int k = 0; k < (int) _data->dataBits.size(); ++k) {
-                        auto freq = freqStart_hz + freqDelta_hz*k;
-                        _data->dataFreqs_hz[k] = freq;
+                _data->pushCommand(command);
+                break;
+            }
+        default:
+            {
+                CG_FATAL(0, "Unknown event %d\n", event);
+                break;
+            }
+    };
+}
 
-                        float phaseOffset = 2*M_PI*::frand();
-                        for (int i = 0; i < _data->samplesPerFrame; i++) {
-                            _data->bitAmplitude[k][i] = std::sin((2.0*M_PI*i)*freq*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
-                        }
-                        for (int i = 0; i < _data->samplesPerFrame; i++) {
-                            _data->bit0Amplitude[k][i] = std::sin((2.0*M_PI*i)*(freq + _data->hzPerFrame)*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
-                        }
+void Core::sendStream(ByteSource && source) {
+    pushStream(Command::SendStream, std::move(source));
+}
 
-                        if (_data->dataBits[k] == false) continue;
+void Core::queueStream(ByteSource && source) {
+    pushStream(Command::QueueStream, std::move(source));
+}
 
-                        CG_INFO(0, "\tBit %d -> %4.2f Hz\n", k, freq);
-                    }
+void Core::pushStream(int type, ByteSource && source) {
+    auto inp = _data->stateInput.lock();
 
-                    for (int k = 0; k < ::Data::Constants::kMaxBitsPerChecksum; ++k) {
-                        _data->checksumAmplitude[k].fill(0);
-                        _data->checksum0Amplitude[k].fill(0);
-                    }
+    if (inp == nullptr) return;
 
-                    _data->frameId = 0;
-                    _data->nRampFrames = _data->nRampFramesBegin;
-                    _data->subFramesPerTx = 0;
-                    _data->waitForNewFrame = true;
-
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingData = true;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer = false;
-                    ++_data->dataId;
-                });
-                break;
-            }
-        case DataOff:
+    int slot = -1;
+    auto src = _data->sources.acquire(slot);
+    if (src == nullptr) {
+        CG_WARN(0, "Too many pending streams - dropping this one\n");
+        return;
+    }
+
+    *src = ::makeStreamSource(std::move(source), inp->useCompression, [this]() { return _data->getRateReport(); });
+
+    Command command;
+    command.type = (Command::Type) type;
+    command.slot = slot;
+    command.subFramesPerTx = inp->subFramesPerTx;
+    if (_data->pushCommand(command) == false) {
+        *src = nullptr;
+        _data->sources.cancel(slot);
+    }
+}
+
+void Core::setReceiveSink(ByteSink && sink) {
+    int slot = -1;
+    auto dst = _data->sinks.acquire(slot);
+    if (dst == nullptr) {
+        CG_WARN(0, "Too many pending receive sinks - dropping this one\n");
+        return;
+    }
+
+    *dst = std::move(sink);
+
+    Command command;
+    command.type = Command::SetReceiveSink;
+    command.slot = slot;
+    if (_data->pushCommand(command) == false) {
+        *dst = nullptr;
+        _data->sinks.cancel(slot);
+    }
+}
+
+void Core::execute(Command & command) {
+    switch (command.type) {
+        case Command::Init:
             {
-                CG_INFO(0, "Data OFF\n");
+                if (_data->isInitialized) return;
 
-                _data->inputQueue.push([this]() {
-                    _data->needRecache = true;
+                _data->isInitialized = false;
+                _data->needRecache = true;
 
-                    _data->frameId = 0;
-                    _data->nRampFrames = _data->nRampFramesEnd;
-                    _data->subFramesPerTx = _data->nRampFramesEnd;
+                _data->stateData[Data::BUFFER_ACTIVE]->frame = nullptr;
+                _data->stateData[Data::BUFFER_ACTIVE]->tones = nullptr;
+                _data->stateData[Data::BUFFER_ACTIVE]->received = nullptr;
 
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingData = false;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer = false;
-                });
+                _data->sampleRate = command.init.sampleRate;
+                _data->samplesPerFrame = command.init.samplesPerFrame;
+                _data->samplesPerSubFrame = command.init.samplesPerSubFrame;
+                _data->isamplesPerFrame = 1.0f/command.init.samplesPerFrame;
+                _data->hzPerFrame = command.init.hzPerFrame;
+                _data->ihzPerFrame = 1.0f/command.init.hzPerFrame;
+
+                _data->free();
+                if (_data->init() == false) return;
+
+                CG_INFO(0, "Hz per frame = %4.4f\n", _data->hzPerFrame);
+
+                _data->isInitialized = true;
+                _data->stateData[Data::BUFFER_ACTIVE]->samplesPerFrame = _data->samplesPerFrame;
+                _data->stateData[Data::BUFFER_ACTIVE]->samplesPerSubFrame = _data->samplesPerSubFrame;
+                _data->needToneSnapshot = true;
+                _data->needReceivedSnapshot = true;
                 break;
             }
-        case DataSend:
+        case Command::DataOn:
             {
-                CG_INFO(0, "Data Send, size = %d\n", (int) strlen(inp->sendData.data()));
+                _data->dataOnArgs.update();
+                const auto & args = _data->dataOnArgs.getReadBuffer();
+
+                _data->needRecache = true;
+                _data->usePAPRReduction = args.usePAPRReduction;
+
+                // measurements of another profile say nothing about this one
+                _data->useRateAdaptation = args.useRateAdaptation;
+                if (_data->rateStepId != args.rateStepId) {
+                    _data->rateStepId = args.rateStepId;
+                    _data->pendingRateStepId = -1;
+                    _data->rateControl.reset();
+                    _data->rateControl.getLinkQuality(args.rateStepId, _data->stateData[Data::BUFFER_ACTIVE]->linkQuality);
+                }
+                _data->nSubFramesPerRx = args.subFramesPerTx;
+                _data->nFramesNotDecoded = 0;
+
+                _data->freqStart_hz = args.freqStart_hz;
+                _data->freqDelta_hz = args.freqDelta_hz;
+                _data->freqCheck_hz = args.freqCheck_hz;
+                _data->encodeIdParity = args.encodeIdParity;
+                _data->useChecksum = args.useChecksum;
+
+                _data->dataBits = args.dataBits;
+                _data->nDataBitsPerTx = args.nDataBitsPerTx;
+                _data->nECCBytesPerTx = args.nECCBytesPerTx;
+
+                _data->useInnerCode = false;
+                _data->nCodewordBytesPerTx = args.nDataBitsPerTx/8;
+                if (args.useInnerCode) {
+                    int nInfoBytes = ConvolutionalCode::getInfoBytes(args.nDataBitsPerTx);
+                    if (args.modulation == ::Data::StateInput::Mod_OFDM) {
+                        CG_WARN(0, "The convolutional inner code is not supported with OFDM\n");
+                    } else if (nInfoBytes < 1) {
+                        CG_WARN(0, "Too few data bits per Tx for the convolutional inner code\n");
+                    } else {
+                        _data->useInnerCode = true;
+                        _data->nCodewordBytesPerTx = nInfoBytes;
+                        CG_INFO(0, "Convolutional inner code: %d bytes per Tx under the outer code\n", nInfoBytes);
+                    }
+                }
 
-                auto sendData = inp->sendData;
-                auto subFramesPerTx = inp->subFramesPerTx;
+                _data->useInterleaving = false;
+                _data->nRxBlockTx = 0;
+                _data->rxBlockParity = -1;
+                _data->rxBlockLastRow = -1;
+                if (args.useInterleaving) {
+                    if (args.modulation == ::Data::StateInput::Mod_OFDM) {
+                        CG_WARN(0, "Interleaving is not supported with OFDM - every OFDM symbol carries its own RS codeword\n");
+                    } else if (args.nParityTxPerBlock < 1 || args.nTxPerBlock <= args.nParityTxPerBlock || args.nTxPerBlock > 255) {
+                        CG_WARN(0, "Invalid interleaving block: %d Tx with %d parity Tx\n", args.nTxPerBlock, args.nParityTxPerBlock);
+                    } else {
+                        int nDataTx = args.nTxPerBlock - args.nParityTxPerBlock;
+                        if (_data->rsBlock == nullptr || _data->rsBlock->MsgLength() != nDataTx || _data->rsBlock->EccLength() != args.nParityTxPerBlock) {
+                            _data->rsBlock = ::makeReedSolomon(nDataTx, args.nParityTxPerBlock);
+                        }
+                        _data->useInterleaving = true;
+                        _data->nTxPerBlock = args.nTxPerBlock;
+                        _data->nParityTxPerBlock = args.nParityTxPerBlock;
 
-                _data->inputQueue.push([this, sendData, subFramesPerTx]() {
-                    _data->needRecache = true;
+                        // the block code replaces the per-Tx one
+                        _data->nECCBytesPerTx = 0;
+                        _data->rs.reset();
+                    }
+                }
 
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingData = true;
-                    _data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer = true;
+                if (_data->useInterleaving) {
+                    CG_INFO(0, "Interleaving: %d Tx per block, %d of them parity\n", args.nTxPerBlock, args.nParityTxPerBlock);
+                } else if (_data->nCodewordBytesPerTx > args.nECCBytesPerTx && args.nECCBytesPerTx > 0) {
+                    int nMsgBytes = _data->nCodewordBytesPerTx - args.nECCBytesPerTx;
+                    if (_data->rs == nullptr || _data->rs->MsgLength() != nMsgBytes || _data->rs->EccLength() != args.nECCBytesPerTx) {
+                        _data->rs = ::makeReedSolomon(nMsgBytes, args.nECCBytesPerTx);
+                    }
+                } else {
+                    CG_WARN(0, "Not using ECC because the specified number of ECC bytes is too big for this protocol\n");
+                    _data->rs.reset();
+                    _data->nECCBytesPerTx = 0;
+                }
 
-                    for (int k = 0; k < ::Data::Constants::kMaxBitsPerChecksum; ++k) {
-                        auto freq = _data->freqCheck_hz + _data->freqDelta_hz*k;
-                        _data->checksumFreqs_hz[k] = freq;
+                _data->useFountain = false;
+                _data->rxFountainGeneration = -1;
+                if (args.useFountain) {
+                    if (args.modulation == ::Data::StateInput::Mod_OFDM) {
+                        CG_WARN(0, "Fountain broadcast is not supported with OFDM\n");
+                    } else if (_data->useInterleaving) {
+                        CG_WARN(0, "Fountain broadcast cannot be combined with interleaving\n");
+                    } else if (_data->rs == nullptr) {
+                        // a corrupted symbol would spoil its whole generation - the per-Tx code turns errors into losses
+                        CG_WARN(0, "Fountain broadcast needs ECC bytes in every Tx\n");
+                    } else if (_data->getBytesPerTx() < ::kFountainHeaderSize + 2) {
+                        CG_WARN(0, "Fountain broadcast needs at least %d bytes per Tx besides the ECC\n", ::kFountainHeaderSize + 2);
+                    } else {
+                        _data->useFountain = true;
+                        _data->fountainOverhead = std::max(0.0f, args.fountainOverhead);
+                        CG_INFO(0, "Fountain broadcast: up to %d chunks per generation\n", kMaxFountainSymbols);
+                    }
+                }
+
+                _data->useFraming = false;
+                _data->frameDecoder.reset();
+                if (args.useFraming) {
+                    if (args.modulation == ::Data::StateInput::Mod_OFDM) {
+                        CG_WARN(0, "Framing is not supported with OFDM\n");
+                    } else if (_data->useInterleaving || _data->useFountain) {
+                        CG_WARN(0, "Framing is not needed with interleaving or fountain broadcast - their Tx carry their own ids\n");
+                    } else if (_data->getChunkBytes() < ::kFrameHeaderSize + 1) {
+                        CG_WARN(0, "Framing needs at least %d bytes per Tx besides the ECC\n", ::kFrameHeaderSize + 1);
+                    } else {
+                        _data->useFraming = true;
+                        CG_INFO(0, "Framing: 7-bit sequence numbers, CRC-32 per message\n");
+                    }
+                }
+
+                for (int k = 0; k < (int) _data->dataBits.size(); ++k) {
+                    auto freq = args.freqStart_hz + args.freqDelta_hz*k;
+                    _data->dataFreqs_hz[k] = freq;
+
+                    float phaseOffset = ::getTonePhase(k, args.nDataBitsPerTx, args.usePAPRReduction);
+                    for (int i = 0; i < _data->samplesPerFrame; i++) {
+                        _data->bitAmplitude[k][i] = std::sin((2.0*M_PI*i)*freq*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
+                    }
+                    for (int i = 0; i < _data->samplesPerFrame; i++) {
+                        _data->bit0Amplitude[k][i] = std::sin((2.0*M_PI*i)*(freq + _data->hzPerFrame)*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
+                    }
+
+                    if (_data->dataBits[k] == false) continue;
+
+                    CG_INFO(0, "\tBit %d -> %4.2f Hz\n", k, freq);
+                }
+
+                _data->modulation = args.modulation;
+
+                if (args.modulation == ::Data::StateInput::Mod_OFDM) {
+                    OFDM::Parameters params;
+                    params.samplesPerFrame = _data->samplesPerFrame;
+                    params.nCyclicPrefix = args.nCyclicPrefix;
+                    params.binStart = std::round(args.freqStart_hz*_data->ihzPerFrame);
+                    params.nBitsPerSymbol = args.nDataBitsPerTx;
+                    params.reducePAPR = args.usePAPRReduction;
+
+                    if (_data->ofdm.init(params)) {
+                        _data->nCyclicPrefix = args.nCyclicPrefix;
+                        CG_INFO(0, "OFDM: %d carriers, %d samples per symbol\n", _data->ofdm.getNumCarriers(), _data->ofdm.getSamplesPerSymbol());
+                    } else {
+                        CG_WARN(0, "Unsupported OFDM parameters - falling back to binary FSK\n");
+                        _data->modulation = ::Data::StateInput::Mod_FSK;
+                    }
+                }
+                _data->ofdmTxSamples.clear();
+                _data->ofdmTxPos = 0;
+
+                // a DPSK symbol is compared with the one a full Tx (including the trailing silent frame) earlier
+                _data->rxPhaseHistoryId = 0;
+                _data->rxPhaseHistory.resize(args.subFramesPerTx + 2);
+                for (auto & h : _data->rxPhaseHistory) {
+                    h.fill(0.0f);
+                }
+                _data->txPhaseSign.fill(1.0f);
+
+                if (_data->modulation == ::Data::StateInput::Mod_DPSK || _data->modulation == ::Data::StateInput::Mod_OFDM) {
+                    _data->nBitsPerTone = 1;
+                } else if (args.nBitsPerTone < 1 || args.nBitsPerTone > ::Data::Constants::kMaxBitsPerTone || args.nDataBitsPerTx % args.nBitsPerTone != 0) {
+                    CG_WARN(0, "Unsupported number of bits per tone %d - falling back to binary FSK\n", args.nBitsPerTone);
+                    _data->nBitsPerTone = 1;
+                } else {
+                    _data->nBitsPerTone = args.nBitsPerTone;
+                }
 
-                        float phaseOffset = 2*M_PI*::frand();
-                        for (int i = 0; i < _data->samplesPerFrame; i++) {
-                            _data->checksumAmplitude[k][i] = std::sin((2.0*M_PI*i)*freq*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
+                if (_data->nBitsPerTone > 1) {
+                    int nTonesPerGroup = 1 << _data->nBitsPerTone;
+                    int nGroups = args.nDataBitsPerTx/_data->nBitsPerTone;
+
+                    if (args.freqDelta_hz < nTonesPerGroup*_data->hzPerFrame) {
+                        CG_WARN(0, "Freq. delta is too small for %d tones per group - neighbouring groups overlap\n", nTonesPerGroup);
+                    }
+
+                    _data->toneAmplitude.resize(nGroups*nTonesPerGroup);
+                    for (int g = 0; g < nGroups; ++g) {
+                        float phaseOffset = ::getTonePhase(g, nGroups, args.usePAPRReduction);
+                        for (int m = 0; m < nTonesPerGroup; ++m) {
+                            auto freq = _data->dataFreqs_hz[g] + m*_data->hzPerFrame;
+                            auto & ampl = _data->toneAmplitude[g*nTonesPerGroup + m];
+                            for (int i = 0; i < _data->samplesPerFrame; i++) {
+                                ampl[i] = std::sin((2.0*M_PI*i)*freq*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
+                            }
                         }
-                        for (int i = 0; i < _data->samplesPerFrame; i++) {
-                            _data->checksum0Amplitude[k][i] = std::sin((2.0*M_PI*i)*(freq + _data->hzPerFrame)*_data->isamplesPerFrame*_data->ihzPerFrame + phaseOffset);
+                    }
+                } else {
+                    _data->toneAmplitude.clear();
+                }
+
+                _data->useArq = false;
+                _data->arqReceiver.reset();
+                _data->lastAckWord = 0;
+                if (args.useArq) {
+                    int ackBin = _data->getAckBin();
+                    if (_data->useFraming == false) {
+                        CG_WARN(0, "ARQ needs framing - the acknowledgements refer to sequence numbers\n");
+                    } else if (ackBin + 2*::kArqAckBits >= _data->samplesPerFrame/2) {
+                        CG_WARN(0, "ARQ: no room for the acknowledgement band above the checksum tones\n");
+                    } else {
+                        _data->useArq = true;
+                        _data->ackBin = ackBin;
+                        _data->ackSinTable.resize(_data->samplesPerFrame);
+                        for (int i = 0; i < _data->samplesPerFrame; ++i) {
+                            _data->ackSinTable[i] = std::sin((2.0*M_PI*i)*_data->isamplesPerFrame);
                         }
+                        CG_INFO(0, "ARQ: window of %d frames, acknowledgements at %4.2f - %4.2f Hz\n", ::kArqWindow,
+                                ackBin*_data->hzPerFrame, (ackBin + 2*::kArqAckBits - 1)*_data->hzPerFrame);
                     }
+                }
 
-                    _data->sendId = 0;
-                    _data->frameId = 0;
-                    _data->curTxSubFrameId = 0;
-                    _data->nRampFrames = _data->nRampFramesBegin;
-                    _data->waitForNewFrame = true;
+                for (int k = 0; k < ::Data::Constants::kMaxBitsPerChecksum; ++k) {
+                    _data->checksumAmplitude[k].fill(0);
+                    _data->checksum0Amplitude[k].fill(0);
+                }
 
-                    _data->subFramesPerTx = subFramesPerTx;
-                    _data->sendData = sendData;
+                _data->frameId = 0;
+                _data->nRampFrames = _data->nRampFramesBegin;
+                _data->subFramesPerTx = 0;
+                _data->waitForNewFrame = true;
 
-                });
+                _data->stateData[Data::BUFFER_ACTIVE]->sendingData = true;
+                _data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer = false;
+                ++_data->dataId;
+                _data->needToneSnapshot = true;
                 break;
             }
-        case DataClear:
+        case Command::DataOff:
             {
-                CG_INFO(0, "Data Clear\n");
+                _data->needRecache = true;
+
+                _data->sendQueue.clear();
+                _data->sendSource = nullptr;
+                _data->txEndOfStream = true;
+                _data->stateData[Data::BUFFER_ACTIVE]->nQueuedMessages = 0;
 
-                _data->inputQueue.push([this]() {
+                _data->frameId = 0;
+                _data->nRampFrames = _data->nRampFramesEnd;
+                _data->subFramesPerTx = _data->nRampFramesEnd;
+
+                _data->stateData[Data::BUFFER_ACTIVE]->sendingData = false;
+                _data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer = false;
+                break;
+            }
+        case Command::DataClear:
+            {
+                _data->needRecache = true;
+
+                _data->receivedId = 0;
+                _data->receivedData.fill(0);
+                _data->needReceivedSnapshot = true;
+                _data->lastChunkStart = 0;
+                _data->rxEndOfStream = true;
+                _data->nRxBlockTx = 0;
+                _data->rxFountainGeneration = -1;
+                _data->frameDecoder.reset();
+                _data->arqReceiver.reset();
+                _data->stateData[Data::BUFFER_ACTIVE]->nBytesReceived = 0;
+                _data->stateData[Data::BUFFER_ACTIVE]->nMessagesReceived = 0;
+                _data->stateData[Data::BUFFER_ACTIVE]->nMessagesCorrupted = 0;
+                break;
+            }
+        case Command::SendStream:
+            {
+                auto & src = _data->sources.slots[command.slot];
+                _data->sendQueue.clear();
+                _data->startSending(std::move(src), command.subFramesPerTx);
+
+                src = nullptr;
+                _data->sources.release(command.slot);
+                break;
+            }
+        case Command::QueueStream:
+            {
+                auto & src = _data->sources.slots[command.slot];
+                if (_data->stateData[Data::BUFFER_ACTIVE]->sendingDataBuffer == false) {
+                    _data->startSending(std::move(src), command.subFramesPerTx);
+                } else if ((int) _data->sendQueue.size() >= ::Data::Constants::kMaxQueuedMessages) {
+                    CG_WARN(0, "Send queue is full - dropping message\n");
+                } else {
                     _data->needRecache = true;
+                    _data->sendQueue.push_back(std::move(src));
+                    _data->stateData[Data::BUFFER_ACTIVE]->nQueuedMessages = _data->sendQueue.size();
+                }
 
-                    _data->receivedId = 0;
-                    _data->receivedData.fill(0);
-                });
+                src = nullptr;
+                _data->sources.release(command.slot);
                 break;
             }
-        default:
+        case Command::SetReceiveSink:
             {
-                CG_FATAL(0, "Unknown event %d\n", event);
+                auto & dst = _data->sinks.slots[command.slot];
+                _data->receiveSink = std::move(dst);
+
+                dst = nullptr;
+                _data->sinks.release(command.slot);
                 break;
             }
     };
@@ -548,10 +2053,22 @@ void Core::input() {
         _data->nRampFramesEnd = inp->nRampFramesEnd;
         _data->nRampFramesBlend = inp->nRampFramesBlend;
         _data->nConfirmFrames = inp->nConfirmFrames;
+
+        if (_data->rampShape != inp->rampShape) {
+            _data->rampShape = inp->rampShape;
+            _data->rampEnvelopes.clear();
+        }
+    }
+
+    if (_data->isInitialized) {
+        _data->getRampEnvelope(_data->nRampFramesBegin);
+        _data->getRampEnvelope(_data->nRampFramesEnd);
+        _data->getRampEnvelope(_data->nRampFramesBlend);
     }
 
-    while (_data->inputQueue.size() > 0) {
-        _data->inputQueue.pop()();
+    Command command;
+    while (_data->inputQueue.try_pop(command)) {
+        execute(command);
     }
 }
 
@@ -569,9 +2086,10 @@ void Core::main() {
             auto sampleFinalId = sampleStartId + _data->samplesPerSubFrame;
 
             // check if receiving data
-            {
+            if (_data->modulation != ::Data::StateInput::Mod_OFDM) {
                 std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> receivedData;
                 static std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> receivedDataLast;
+                std::array<std::int8_t, ::Data::Constants::kMaxDataBits> softBits;
                 std::uint16_t requiredChecksum = 0;
                 std::uint16_t curChecksum = 0;
                 std::uint8_t curParity = 0;
@@ -607,13 +2125,64 @@ void Core::main() {
                     }
                 }
 
-                for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
-                    int bin = std::round(_data->dataFreqs_hz[k]*_data->ihzPerFrame);
-                    if (_data->historySpectrumAverage[bin] > 1.0*_data->historySpectrumAverage[bin + 1]) {
-                        receivedData[k/8] += (1 << (k%8));
-                    } else {
-                        if (_data->useChecksum) {
-                            requiredChecksum += (1 << ((k%8)+2));
+                if (_data->modulation == ::Data::StateInput::Mod_DPSK) {
+                    // DPSK: a phase flip with respect to the previous Tx is a 1
+                    int nHistory = _data->rxPhaseHistory.size();
+                    const auto & cur = _data->rxPhaseHistory[(_data->rxPhaseHistoryId + nHistory - 1) % nHistory];
+                    const auto & prev = _data->rxPhaseHistory[_data->rxPhaseHistoryId];
+                    for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                        float corr = std::real(cur[k]*std::conj(prev[k]));
+                        float norm = std::abs(cur[k])*std::abs(prev[k]);
+                        softBits[k] = ::getSoftBit(norm - corr, norm + corr);
+                        if (corr < 0.0f) {
+                            receivedData[k/8] += (1 << (k%8));
+                        } else {
+                            if (_data->useChecksum) {
+                                requiredChecksum += (1 << ((k%8)+2));
+                            }
+                        }
+                    }
+                } else if (_data->nBitsPerTone == 1) {
+                    for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                        int bin = std::round(_data->dataFreqs_hz[k]*_data->ihzPerFrame);
+                        softBits[k] = ::getSoftBit(_data->historySpectrumAverage[bin], _data->historySpectrumAverage[bin + 1]);
+                        if (_data->historySpectrumAverage[bin] > 1.0*_data->historySpectrumAverage[bin + 1]) {
+                            receivedData[k/8] += (1 << (k%8));
+                        } else {
+                            if (_data->useChecksum) {
+                                requiredChecksum += (1 << ((k%8)+2));
+                            }
+                        }
+                    }
+                } else {
+                    // MFSK: the strongest bin in each group gives the value of its bits
+                    int nTonesPerGroup = 1 << _data->nBitsPerTone;
+                    int nGroups = _data->nDataBitsPerTx/_data->nBitsPerTone;
+                    for (int g = 0; g < nGroups; ++g) {
+                        int bin = std::round(_data->dataFreqs_hz[g]*_data->ihzPerFrame);
+                        int mMax = 0;
+                        for (int m = 1; m < nTonesPerGroup; ++m) {
+                            if (_data->historySpectrumAverage[bin + m] > _data->historySpectrumAverage[bin + mMax]) mMax = m;
+                        }
+                        int value = nTonesPerGroup - 1 - mMax;
+                        for (int j = 0; j < _data->nBitsPerTone; ++j) {
+                            int k = g*_data->nBitsPerTone + j;
+
+                            // strongest tone with the bit set against the strongest one without it
+                            float best[2] = { 0.0f, 0.0f };
+                            for (int m = 0; m < nTonesPerGroup; ++m) {
+                                int b = ((nTonesPerGroup - 1 - m) >> j) & 1;
+                                best[b] = std::max(best[b], _data->historySpectrumAverage[bin + m]);
+                            }
+                            softBits[k] = ::getSoftBit(best[1], best[0]);
+
+                            if (value & (1 << j)) {
+                                receivedData[k/8] += (1 << (k%8));
+                            } else {
+                                if (_data->useChecksum) {
+                                    requiredChecksum += (1 << ((k%8)+2));
+                                }
+                            }
                         }
                     }
                 }
@@ -628,49 +2197,83 @@ void Core::main() {
 
                 requiredChecksum = (requiredChecksum & ((1 << ::Data::Constants::kMaxBitsPerChecksum) - 1));
 
-                isValid = _data->useChecksum ? (curChecksum == requiredChecksum) || (curChecksum == (requiredChecksum ^ (1 << 1))) : data->receivingData;
+                if (_data->useInnerCode) {
+                    // the RS decoder below works on the Viterbi output instead of the hard decisions
+                    receivedData.fill(0);
+                    _data->innerCode.decode(softBits.data(), _data->nCodewordBytesPerTx, receivedData.data());
+                }
+
+                bool useChecksum = _data->useChecksum && _data->useInterleaving == false;
+                isValid = useChecksum ? (curChecksum == requiredChecksum) || (curChecksum == (requiredChecksum ^ (1 << 1))) : data->receivingData;
                 bool checksumMatch = (lastChecksum == curChecksum);
 
+                std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> receivedRaw = receivedData;
                 if (_data->rs) {
                     static std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> repaired;
                     bool decoded = true;
                     if (_data->rs->Decode(receivedData.data(), repaired.data()) != 0) {
                         decoded = false;
                     } else {
-                        for (int i = 0; i < _data->nDataBitsPerTx/8 - _data->nECCBytesPerTx; ++i) {
+                        for (int i = 0; i < _data->getBytesPerTx(); ++i) {
                             receivedData[i] = repaired[i];
                         }
-                        receivedData[_data->nDataBitsPerTx/8 - _data->nECCBytesPerTx] = 0;
+                        receivedData[_data->getBytesPerTx()] = 0;
                     }
                     checksumMatch = true;
                     isValid &= decoded;
                 }
 
-                if (isValid && checksumMatch) {
-                    for (int i = 0; i < _data->nDataBitsPerTx/8 - _data->nECCBytesPerTx; ++i) {
-                        if (receivedData[i] == 0) receivedData[i] = ' ';
+                if (isValid && checksumMatch && _data->useInterleaving) {
+                    // the checksum tones carry the block parity and the position of the Tx in the block
+                    if (++nTimesReceived == _data->nConfirmFrames) {
+                        _data->receiveBlockTx(curChecksum >> 2, curParity, receivedData.data());
+                    }
+                } else if (isValid && checksumMatch && _data->useFountain) {
+                    // the symbol header identifies the Tx - repeats are dropped by the decoder
+                    if (++nTimesReceived == _data->nConfirmFrames) {
+                        _data->addLinkFrame(_data->estimateSNR_dB(), receivedRaw.data(), receivedData.data());
+                        _data->receiveFountainTx(receivedData.data());
                     }
-                    if (++nTimesReceived == _data->nConfirmFrames && receivedData != receivedDataLast) {
+                } else if (isValid && checksumMatch && _data->useFraming) {
+                    // the sequence number tells new frames from repeats - no Tx id parity or gap timing needed
+                    static int lastFrameSeq = -1;
+                    int seq = receivedData[1] & ::kFrameSeqMask;
+                    if (seq != lastFrameSeq) {
+                        lastFrameSeq = seq;
+                        nTimesReceived = 0;
+                    }
+                    if (++nTimesReceived == _data->nConfirmFrames) {
+                        _data->addLinkFrame(_data->estimateSNR_dB(), receivedRaw.data(), receivedData.data());
+                        if (_data->useArq) {
+                            _data->receiveArqFrame(receivedData.data());
+                        } else {
+                            _data->receiveFrame(receivedData.data());
+                        }
+                    }
+                } else if (isValid && checksumMatch) {
+                    // identical consecutive chunks are told apart by the Tx id parity
+                    bool isNew = (receivedData != receivedDataLast) || (_data->encodeIdParity && curParity != lastParity);
+                    if (++nTimesReceived == _data->nConfirmFrames && isNew) {
                         receivedDataLast = receivedData;
                         lastReceivedChecksum = curChecksum;
 
-                        CG_WARN(0, "Receiving data: %s\n", receivedData.data());
+                        _data->addLinkFrame(_data->estimateSNR_dB(), receivedRaw.data(), receivedData.data());
+
+                        CG_WARN(0, "Receiving data: %d bytes\n", receivedData[0] & ::kChunkSizeMask);
                         static auto tLast = std::chrono::steady_clock::now();
                         auto tNow = std::chrono::steady_clock::now();
+                        bool isRepeat = false;
                         if (std::chrono::duration_cast<std::chrono::milliseconds>(tNow - tLast).count() > 500) {
-                            _data->receivedId = 0;
-                            _data->receivedData.fill(0);
+                            _data->rxEndOfStream = true;
                         } else {
-                            if (curParity == lastParity && _data->receivedId > 0 && _data->encodeIdParity) {
-                                _data->receivedId -= _data->nDataBitsPerTx/8 - _data->nECCBytesPerTx;
+                            if (curParity == lastParity && _data->rxEndOfStream == false && _data->encodeIdParity) {
+                                isRepeat = true;
                             }
                         }
                         lastParity = curParity;
                         tLast = tNow;
 
-                        for (int i = 0; i < _data->nDataBitsPerTx/8 - _data->nECCBytesPerTx; ++i) {
-                            _data->receivedData[_data->receivedId++] = receivedData[i];
-                        }
+                        _data->receiveChunk(receivedData.data(), isRepeat);
                     }
                 } else if (isValid && (checksumMatch == false)) {
                     lastChecksum = curChecksum;
@@ -679,6 +2282,14 @@ void Core::main() {
                     lastChecksum = -1;
                     nTimesReceived = 0;
                 }
+
+                // a whole Tx heard without a single decodable frame counts as a failure
+                if (isValid || data->receivingData == false) {
+                    _data->nFramesNotDecoded = 0;
+                } else if (++_data->nFramesNotDecoded >= std::max(1, _data->nSubFramesPerRx)) {
+                    _data->nFramesNotDecoded = 0;
+                    _data->addLinkFailure();
+                }
             }
 
             // store spectrum in history
@@ -702,21 +2313,40 @@ void Core::main() {
                 if (++_data->historyId >= ::Data::Constants::kMaxSpectrumHistory) _data->historyId = 0;
             }
 
+            _data->publishFrame();
+
+            // a node that is acknowledging hears its own acknowledgement band
+            bool isSendingAck = _data->isSendingAck();
+            if (_data->useArq && data->sendingData && isSendingAck == false) {
+                _data->receiveAck();
+            }
+
             if (subFrame == 0) {
                 _data->waitForNewFrame = false;
             }
 
             // prepare data to send
-            if (data->sendingDataBuffer && !_data->waitForNewFrame) {
+            if (data->sendingDataBuffer && !_data->waitForNewFrame && _data->modulation != ::Data::StateInput::Mod_OFDM) {
+                bool hasData = true;
                 if (_data->curTxSubFrameId >= _data->subFramesPerTx) {
                     _data->curTxSubFrameId = 0;
                     _data->frameId = 0;
-                    _data->sendId += _data->nDataBitsPerTx/8 - _data->nECCBytesPerTx;
+                    ++_data->nTxSent;
+                    if (_data->sendPhaseReference) {
+                        _data->sendPhaseReference = false;
+                    } else if (_data->useInterleaving) {
+                        hasData = _data->readNextBlockTx();
+                    } else if (_data->useFountain) {
+                        _data->readNextFountainTx();
+                    } else {
+                        hasData = _data->readNextChunk();
+                    }
                 } else if (_data->curTxSubFrameId >= _data->nRampFrames) {
                     _data->nRampFrames = _data->nRampFramesBlend;
                 }
 
-                if (_data->sendData[_data->sendId] == 0) {
+                if (hasData == false) {
+                    _data->needRecache = true;
                     data->sendingData = false;
                     data->sendingDataBuffer = false;
                     _data->nRampFrames = _data->nRampFramesEnd;
@@ -724,12 +2354,22 @@ void Core::main() {
                     _data->curTxSubFrameId = _data->frameId;
 
                     static std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> encoded;
-                    if (_data->rs) {
-                        _data->rs->Encode(_data->sendData.data() + _data->sendId, encoded.data());
+                    if (_data->sendPhaseReference) {
+                        encoded.fill(0);
+                    } else if (_data->useInterleaving) {
+                        auto row = _data->txBlock.begin() + _data->getTxBlockRow()*_data->nCodewordBytesPerTx;
+                        std::copy(row, row + _data->nCodewordBytesPerTx, encoded.begin());
+                    } else if (_data->useFountain) {
+                        _data->encodeFountainTx(encoded.data());
                     } else {
-                        for (int j = 0; j < _data->nDataBitsPerTx/8; ++j) {
-                            encoded[j] = _data->sendData[_data->sendId + j];
-                        }
+                        _data->encodeChunk(encoded.data());
+                    }
+
+                    if (_data->useInnerCode) {
+                        static std::array<std::uint8_t, ::Data::Constants::kMaxDataBits/8> coded;
+                        coded.fill(0);
+                        ::ConvolutionalCode::encode(encoded.data(), _data->nCodewordBytesPerTx, coded.data());
+                        encoded = coded;
                     }
 
                     for (int j = 0; j < _data->nDataBitsPerTx/8; ++j) {
@@ -748,7 +2388,7 @@ void Core::main() {
                 checksum += (1 << 0);
 
                 if (_data->encodeIdParity) {
-                    if ((_data->dataId + _data->sendId/(_data->nDataBitsPerTx/8 - _data->nECCBytesPerTx)) & 1) {
+                    if ((_data->dataId + _data->nTxSent) & 1) {
                         checksum += (1 << 1);
                     }
                 }
@@ -757,17 +2397,78 @@ void Core::main() {
                     _data->outputBlockTmp[i] = 0.0f;
                 }
 
-                for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
-                    ++nFreq;
-                    if (_data->dataBits[k] == false) {
-                        checksum += (1 << ((k%8)+2));
-                        ::addAmplitude(_data->bit0Amplitude[k], _data->outputBlockTmp, _data->sendVolume, sampleStartId, sampleFinalId);
-                        continue;
+                if (_data->modulation == ::Data::StateInput::Mod_OFDM) {
+                    // OFDM: stream the precomputed packet, then continue with the queued messages
+                    if (data->sendingDataBuffer && _data->ofdmTxPos >= (int) _data->ofdmTxSamples.size()) {
+                        if (_data->txEndOfStream == false || _data->sendNextQueued()) {
+                            ++_data->nTxSent;
+                            _data->buildOFDMPacket();
+                        } else {
+                            data->sendingData = false;
+                            data->sendingDataBuffer = false;
+                            _data->needRecache = true;
+                        }
+                    }
+
+                    int nLeft = std::max(0, std::min(_data->samplesPerSubFrame, (int) _data->ofdmTxSamples.size() - _data->ofdmTxPos));
+                    for (int i = 0; i < nLeft; ++i) {
+                        _data->outputBlockTmp[sampleStartId + i] = _data->sendVolume*_data->ofdmTxSamples[_data->ofdmTxPos + i];
+                    }
+                    _data->ofdmTxPos += nLeft;
+                    nFreq = 1;
+                } else if (_data->modulation == ::Data::StateInput::Mod_DPSK) {
+                    // DPSK: a single tone per bit, flip its phase at the start of the Tx to send a 1
+                    if (_data->frameId == 0) {
+                        for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                            if (_data->dataBits[k]) _data->txPhaseSign[k] = -_data->txPhaseSign[k];
+                        }
+                    }
+                    for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                        ++nFreq;
+                        if (_data->dataBits[k] == false) {
+                            checksum += (1 << ((k%8)+2));
+                        }
+                        ::addAmplitude(_data->bitAmplitude[k], _data->outputBlockTmp, _data->txPhaseSign[k]*_data->sendVolume, sampleStartId, sampleFinalId);
+                    }
+                } else if (_data->nBitsPerTone == 1) {
+                    for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                        ++nFreq;
+                        if (_data->dataBits[k] == false) {
+                            checksum += (1 << ((k%8)+2));
+                            ::addAmplitude(_data->bit0Amplitude[k], _data->outputBlockTmp, _data->sendVolume, sampleStartId, sampleFinalId);
+                            continue;
+                        }
+                        ::addAmplitude(_data->bitAmplitude[k], _data->outputBlockTmp, _data->sendVolume, sampleStartId, sampleFinalId);
                     }
-                    ::addAmplitude(_data->bitAmplitude[k], _data->outputBlockTmp, _data->sendVolume, sampleStartId, sampleFinalId);
+                } else {
+                    // MFSK: light exactly one of the tones in each group
+                    int nTonesPerGroup = 1 << _data->nBitsPerTone;
+                    int nGroups = _data->nDataBitsPerTx/_data->nBitsPerTone;
+                    for (int g = 0; g < nGroups; ++g) {
+                        int value = 0;
+                        for (int j = 0; j < _data->nBitsPerTone; ++j) {
+                            int k = g*_data->nBitsPerTone + j;
+                            if (_data->dataBits[k]) {
+                                value |= (1 << j);
+                            } else {
+                                checksum += (1 << ((k%8)+2));
+                            }
+                        }
+                        ++nFreq;
+                        ::addAmplitude(_data->toneAmplitude[g*nTonesPerGroup + (nTonesPerGroup - 1 - value)], _data->outputBlockTmp, _data->sendVolume, sampleStartId, sampleFinalId);
+                    }
+                }
+
+                if (_data->useInterleaving) {
+                    // block parity and position of the Tx in the block instead of the Tx id parity and the checksum
+                    // the DPSK phase reference is sent with an invalid position
+                    int row = _data->sendPhaseReference ? 0xFF : _data->getTxBlockRow();
+                    checksum = (1 << 0) | ((_data->txBlockId & 1) << 1) | (row << 2);
                 }
 
-                if (_data->rs == nullptr) {
+                if (_data->modulation == ::Data::StateInput::Mod_OFDM) {
+                    // the packet carries its own training and header symbols
+                } else if (_data->rs == nullptr) {
                     for (int k = 0; k < ::Data::Constants::kMaxBitsPerChecksum; ++k) {
                         ++nFreq;
                         if ((checksum & (1 << k)) || (k == 0)) {
@@ -789,6 +2490,14 @@ void Core::main() {
 
                 if (nFreq == 0) nFreq = 1;
                 float scale = 1.0f/nFreq;
+                if (_data->usePAPRReduction && _data->modulation != ::Data::StateInput::Mod_OFDM) {
+                    // scale by the actual peak of the block instead of assuming that all tones add up in phase
+                    float peak = 0.0f;
+                    for (int i = sampleStartId; i < sampleFinalId; ++i) {
+                        peak = std::max(peak, std::fabs(_data->outputBlockTmp[i]));
+                    }
+                    if (peak > 0.0f) scale = _data->sendVolume/peak;
+                }
                 for (int i = sampleStartId; i < sampleFinalId; ++i) {
                     _data->outputBlockTmp[i] *= scale;
                 }
@@ -798,40 +2507,39 @@ void Core::main() {
                 }
             }
 
-            static double interp = 0.0;
-            if (_data->frameId == 0 && _data->sendId == 0) {
-                interp = 0.0f;
-            }
-            double dinterp = 1.0/(_data->nRampFrames*_data->samplesPerSubFrame);
-            if (_data->frameId < _data->nRampFrames) {
-                for (int i = sampleStartId; i < sampleFinalId; ++i) {
-                    interp = std::min(1.0, interp + dinterp);
-                    _data->outputBlock[i] = interp*_data->outputBlockTmp[i];
-                }
-            } else if (_data->subFramesPerTx > 0 && _data->frameId >= _data->subFramesPerTx - _data->nRampFrames) {
-                for (int i = sampleStartId; i < sampleFinalId; ++i) {
-                    interp = std::max(0.0, interp - dinterp);
-                    _data->outputBlock[i] = interp*_data->outputBlockTmp[i];
-                }
-            } else {
-                interp = 1.0;
-                for (int i = sampleStartId; i < sampleFinalId; ++i) {
-                    _data->outputBlock[i] = _data->outputBlockTmp[i];
+            {
+                // nRampFrames switches to the blend length after the first ramp up - the ramp up keeps the length it
+                // started with, so that it never goes back down
+                if (_data->frameId == 0) _data->nRampFramesUp = _data->nRampFrames;
+
+                const auto & rampUp = _data->getRampEnvelope(_data->nRampFramesUp);
+                const auto & ramp = _data->getRampEnvelope(_data->nRampFrames);
+                const float * src = _data->outputBlockTmp.data() + sampleStartId;
+                float * dst = _data->outputBlock.data() + sampleStartId;
+
+                if (_data->modulation == ::Data::StateInput::Mod_OFDM) {
+                    std::copy(src, src + _data->samplesPerSubFrame, dst);
+                } else if (_data->frameId < _data->nRampFramesUp) {
+                    ::applyEnvelope(src, rampUp.up.data() + _data->frameId*_data->samplesPerSubFrame, dst, _data->samplesPerSubFrame);
+                } else if (_data->subFramesPerTx > 0 && _data->frameId >= _data->subFramesPerTx - _data->nRampFrames) {
+                    int rampFrameId = _data->frameId - (_data->subFramesPerTx - _data->nRampFrames);
+                    if (rampFrameId < _data->nRampFrames) {
+                        ::applyEnvelope(src, ramp.down.data() + rampFrameId*_data->samplesPerSubFrame, dst, _data->samplesPerSubFrame);
+                    } else {
+                        std::fill(dst, dst + _data->samplesPerSubFrame, 0.0f);
+                    }
+                } else {
+                    std::copy(src, src + _data->samplesPerSubFrame, dst);
                 }
             }
 
-            // read data
-            int nBytesRecorded = 0;
-            while (true) {
-                nBytesRecorded = SDL_DequeueAudio(_data->devid_in, _data->sampleAmplitude.data() + sampleStartId, sizeof(float)*_data->samplesPerSubFrame);
-                if (nBytesRecorded != 0) {
-                    break;
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (isSendingAck) {
+                _data->addAckTones(sampleStartId, sampleFinalId);
             }
-            if (nBytesRecorded < 0) {
-                CG_FATAL(0, "Unable to capture data\n");
-                continue;
+
+            // read data - the capture callback wakes us up once the whole sub-frame is in
+            while (::getCapture().pop(_data->sampleAmplitude.data() + sampleStartId, _data->samplesPerSubFrame, ::kCaptureTimeout_ms) == false) {
+                if (_data->isRunning == false) break;
             }
 
             // calculate spectrum
@@ -852,8 +2560,34 @@ void Core::main() {
 
             _data->sampleSpectrum = _data->sampleSpectrumTmp;
 
-            if (data->sendingData) {
-                if (_data->sendId < 4) {
+            if (_data->modulation == ::Data::StateInput::Mod_DPSK && _data->rxPhaseHistory.size() > 0) {
+                auto & cur = _data->rxPhaseHistory[_data->rxPhaseHistoryId];
+                for (int k = 0; k < _data->nDataBitsPerTx; ++k) {
+                    int bin = std::round(_data->dataFreqs_hz[k]*_data->ihzPerFrame);
+                    cur[k] = std::complex<float>(_data->fftOut[bin][0], _data->fftOut[bin][1]);
+                }
+                if (++_data->rxPhaseHistoryId >= (int) _data->rxPhaseHistory.size()) _data->rxPhaseHistoryId = 0;
+            }
+
+            if (_data->modulation == ::Data::StateInput::Mod_OFDM) {
+                _data->ofdm.decode(_data->sampleAmplitude.data() + sampleStartId, _data->samplesPerSubFrame,
+                                   [this](int symbolId, int nSymbols, const std::uint8_t * symbol) {
+                                       _data->receiveOFDMSymbol(symbolId, nSymbols, symbol);
+                                   });
+
+                bool receiving = _data->ofdm.isReceiving();
+                if (data->receivingData != receiving) {
+                    _data->needRecache = true;
+                    data->receivingData = receiving;
+                }
+            }
+
+            if (data->sendingData || isSendingAck) {
+                // the acknowledgements alone are not held back
+                bool prebuffer = data->sendingData && ((_data->modulation == ::Data::StateInput::Mod_OFDM) ?
+                    (data->sendingDataBuffer && _data->nTxSent == 0 && _data->ofdmTxPos < 4*_data->samplesPerSubFrame) :
+                    (_data->nTxSent == 0));
+                if (prebuffer) {
                     SDL_PauseAudioDevice(_data->devid_out, SDL_TRUE);
                 } else {
                     SDL_PauseAudioDevice(_data->devid_out, SDL_FALSE);
@@ -869,13 +2603,30 @@ void Core::main() {
                 SDL_PauseAudioDevice(_data->devid_out, SDL_FALSE);
             }
 
+            // the rest of the block is not coming - decode with what has been received
+            if (_data->nRxBlockTx > 0 &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _data->tLastBlockTx).count() > _data->getBlockTimeout_ms()) {
+                _data->finishBlock();
+                _data->rxBlockLastRow = -1;
+            }
+
+            if (_data->pendingRateStepId >= 0 && data->sendingData == false &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _data->tLastReceived).count() > ::kRateSwitchDelay_ms) {
+                _data->setRateStep(_data->pendingRateStepId);
+            }
+
             ++data->nIterations;
             if (!_data->waitForNewFrame) ++_data->frameId;
         }
 
-        if ((int) SDL_GetQueuedAudioSize(_data->devid_in) > 32*sizeof(float)*_data->samplesPerFrame) {
-            printf("nIter = %d, Queue size: %d\n", data->nIterations, SDL_GetQueuedAudioSize(_data->devid_in));
-            SDL_ClearQueuedAudio(_data->devid_in);
+        {
+            auto & capture = ::getCapture();
+            if ((int) capture.samples.size() > 16*_data->samplesPerFrame) {
+                printf("nIter = %d, Queue size: %d\n", data->nIterations, capture.flush());
+            }
+            if (int nDropped = capture.nDropped.exchange(0)) {
+                CG_WARN(0, "Capture buffer is full - dropped %d samples\n", nDropped);
+            }
         }
 
         cache();
@@ -885,13 +2636,13 @@ void Core::main() {
 void Core::cache() {
     if (_data->needRecache == false) return;
 
-    std::lock_guard<std::mutex> lock(_data->mutexStateData);
+    _data->publishPending();
 
     auto & bsrc = _data->stateData[Data::BUFFER_ACTIVE];
-    auto & bdst = _data->stateData[Data::BUFFER_CACHED];
+    auto & bdst = _data->stateSnapshots.getWriteBuffer();
 
-    ::updateStateData(bsrc.get(), bdst.get());
+    ::updateStateData(bsrc.get(), &bdst);
 
-    _data->cacheUpdated = true;
+    _data->stateSnapshots.publish();
     _data->needRecache = false;
 }
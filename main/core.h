@@ -6,6 +6,8 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
+#include <functional>
 
 namespace Data {
 struct StateData;
@@ -30,15 +32,30 @@ public:
         DataOff,
         DataTap,
         DataSend,
+        DataQueue,
+        DataLinkReport,
         DataClear,
     };
 
     void addEvent(Event event);
 
+    // pulls up to n payload bytes into dst and returns how many were written - 0 ends the stream
+    using ByteSource = std::function<int(std::uint8_t * dst, int n)>;
+    // receives the decoded payload bytes of a stream, isEnd is set with its last chunk
+    using ByteSink = std::function<void(const std::uint8_t * src, int n, bool isEnd)>;
+
+    void sendStream(ByteSource && source);
+    void queueStream(ByteSource && source);
+    void setReceiveSink(ByteSink && sink);
+
 private:
+    struct Command;
+
     void input();
     void main();
     void cache();
+    void execute(Command & command);
+    void pushStream(int type, ByteSource && source);
 
     struct Data;
     std::unique_ptr<Data> _data;
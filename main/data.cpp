@@ -23,8 +23,41 @@ namespace Data {
         "86B/s, Protocol 2",
         "172B/s, Protocol 1",
         "258B/s, Protocol 1",
+        "172B/s, MFSK-4",
+        "86B/s, MFSK-16",
+        "344B/s, DPSK",
+        "1050B/s, OFDM",
     };
 
+    const char * StateInput::rampShapeNames[] = {
+        "Linear",
+        "Raised Cosine",
+    };
+
+    const char * StateInput::modulationNames[] = {
+        "FSK",
+        "DPSK",
+        "OFDM",
+    };
+
+    // from the most robust to the fastest profile, with the SNR needed to step up to each of them
+    const StateInput::RateStep StateInput::rateLadder[] = {
+        { BW16_Stable,       0.0f },
+        { BW43_Protocol1,   10.0f },
+        { BW166_Protocol1,  12.0f },
+        { BW172_Protocol1,  15.0f },
+        { BW258_Protocol1,  18.0f },
+        { BW344_DPSK,       20.0f },
+        { BW1050_OFDM,      22.0f },
+    };
+
+    int StateInput::getRateStepId(ConfigId cid) {
+        for (int i = 0; i < Constants::kRateLadderSize; ++i) {
+            if (rateLadder[i].configId == cid) return i;
+        }
+        return -1;
+    }
+
     StateInput StateInput::getDefaultConfig(ConfigId cid) {
         StateInput cfg;
 
@@ -300,11 +333,101 @@ namespace Data {
                 cfg.freqStart_hz = 52*cfg.getHzPerFrame();
                 cfg.freqCheck_hz = 440*cfg.getHzPerFrame();
 
+                break;
+            case BW172_MFSK4:
+                cfg.sampleRate = Constants::kDefaultSamplingRate;
+                cfg.samplesPerFrame = Constants::kMaxSamplesPerFrame;
+                cfg.samplesPerSubFrame = cfg.samplesPerFrame/Constants::kSubFrames;
+                cfg.nRampFramesBegin = 16*Constants::kFactor;
+                cfg.nRampFramesEnd = 16*Constants::kFactor;
+                cfg.nRampFramesBlend = 16*Constants::kFactor;
+                cfg.nConfirmFrames = 4*Constants::kFactor;
+                cfg.subFramesPerTx = 32*Constants::kFactor;
+                cfg.nDataBitsPerTx = 8*16;
+                cfg.nBitsPerTone = 2;
+
+                cfg.encodeIdParity = true;
+
+                cfg.sendVolume = 0.1f;
+                cfg.sendDuration_ms = 100.0f;
+
+                cfg.freqDelta_hz =   4*cfg.getHzPerFrame();
+                cfg.freqStart_hz =  40*cfg.getHzPerFrame();
+                cfg.freqCheck_hz = 400*cfg.getHzPerFrame();
+
+                break;
+            case BW86_MFSK16:
+                cfg.sampleRate = Constants::kDefaultSamplingRate;
+                cfg.samplesPerFrame = Constants::kMaxSamplesPerFrame;
+                cfg.samplesPerSubFrame = cfg.samplesPerFrame/Constants::kSubFrames;
+                cfg.nRampFramesBegin = 16*Constants::kFactor;
+                cfg.nRampFramesEnd = 16*Constants::kFactor;
+                cfg.nRampFramesBlend = 16*Constants::kFactor;
+                cfg.nConfirmFrames = 4*Constants::kFactor;
+                cfg.subFramesPerTx = 32*Constants::kFactor;
+                cfg.nDataBitsPerTx = 8*8;
+                cfg.nBitsPerTone = 4;
+
+                cfg.encodeIdParity = true;
+
+                cfg.sendVolume = 0.1f;
+                cfg.sendDuration_ms = 100.0f;
+
+                cfg.freqDelta_hz =  16*cfg.getHzPerFrame();
+                cfg.freqStart_hz =  40*cfg.getHzPerFrame();
+                cfg.freqCheck_hz = 320*cfg.getHzPerFrame();
+
+                break;
+            case BW344_DPSK:
+                cfg.sampleRate = Constants::kDefaultSamplingRate;
+                cfg.samplesPerFrame = Constants::kMaxSamplesPerFrame;
+                cfg.samplesPerSubFrame = cfg.samplesPerFrame/Constants::kSubFrames;
+                cfg.nRampFramesBegin = 16*Constants::kFactor;
+                cfg.nRampFramesEnd = 16*Constants::kFactor;
+                cfg.nRampFramesBlend = 16*Constants::kFactor;
+                cfg.nConfirmFrames = 4*Constants::kFactor;
+                cfg.subFramesPerTx = 32*Constants::kFactor;
+                cfg.nDataBitsPerTx = 8*32;
+                cfg.modulation = Mod_DPSK;
+
+                cfg.encodeIdParity = true;
+
+                cfg.sendVolume = 0.1f;
+                cfg.sendDuration_ms = 100.0f;
+
+                cfg.freqDelta_hz =   1*cfg.getHzPerFrame();
+                cfg.freqStart_hz = 100*cfg.getHzPerFrame();
+                cfg.freqCheck_hz = 400*cfg.getHzPerFrame();
+
+                break;
+            case BW1050_OFDM:
+                cfg.sampleRate = Constants::kDefaultSamplingRate;
+                cfg.samplesPerFrame = Constants::kMaxSamplesPerFrame;
+                cfg.samplesPerSubFrame = cfg.samplesPerFrame/Constants::kSubFrames;
+                cfg.nRampFramesBegin = 16*Constants::kFactor;
+                cfg.nRampFramesEnd = 16*Constants::kFactor;
+                cfg.nRampFramesBlend = 16*Constants::kFactor;
+                cfg.nConfirmFrames = 1;
+                cfg.subFramesPerTx = 32*Constants::kFactor;
+                cfg.nDataBitsPerTx = 8*32;
+                cfg.modulation = Mod_OFDM;
+                cfg.nCyclicPrefix = 256;
+
+                cfg.encodeIdParity = false;
+
+                cfg.sendVolume = 0.1f;
+                cfg.sendDuration_ms = 100.0f;
+
+                cfg.freqDelta_hz =   1*cfg.getHzPerFrame();
+                cfg.freqStart_hz =  40*cfg.getHzPerFrame();
+                cfg.freqCheck_hz = 400*cfg.getHzPerFrame();
+
                 break;
             default:
                 break;
         };
 
+        cfg.configId = cid;
         cfg.nConfirmFrames = std::max(1, cfg.nConfirmFrames);
 
         cfg.nRampFramesBegin = std::round(cfg.nRampFramesBegin);
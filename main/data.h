@@ -7,7 +7,9 @@
 
 #include <vector>
 #include <array>
+#include <memory>
 #include <cstring>
+#include <algorithm>
 
 namespace Data {
 
@@ -17,14 +19,21 @@ constexpr auto kSubFrames = 1;
 constexpr auto kFactor = ((float)(kSubFrames))/8;
 constexpr auto kMaxSamplesPerFrame = 1024;
 constexpr auto kMaxDataBits = 256;
+constexpr auto kMaxBitsPerTone = 4;
 constexpr auto kMaxBitsPerChecksum = 10;
 constexpr auto kMaxSpectrumHistory = 2*kSubFrames;
 constexpr auto ikMaxSpectrumHistory = 1.0/kMaxSpectrumHistory;
 constexpr auto kMaxDataSize = 1024;
+constexpr auto kMaxQueuedMessages = 8;
+constexpr auto kOFDMPilotSpacing = 8;
+constexpr auto kOFDMSymbolsPerPacket = 32;
+constexpr auto kMaxFilePath = 256;
+constexpr auto kRateLadderSize = 7;
 }
 
 using AmplitudeData = std::array<float, 2*Constants::kMaxSamplesPerFrame>;
 using SpectrumData  = std::array<float,   Constants::kMaxSamplesPerFrame>;
+using SendData      = std::array<char,    Constants::kMaxDataSize>;
 
 struct StateInput {
     enum ConfigId {
@@ -41,34 +50,107 @@ struct StateInput {
         BW166_Protocol2,
         BW172_Protocol1,
         BW258_Protocol1,
+        BW172_MFSK4,
+        BW86_MFSK16,
+        BW344_DPSK,
+        BW1050_OFDM,
         COUNT,
     };
 
+    enum RampShape {
+        Ramp_Linear,
+        Ramp_RaisedCosine,
+        Ramp_COUNT,
+    };
+
+    enum Modulation {
+        Mod_FSK,
+        Mod_DPSK,
+        Mod_OFDM,
+        Mod_COUNT,
+    };
+
+    struct RateStep {
+        ConfigId configId;
+        float minSNR_dB;
+    };
+
     StateInput() {
         dataBits.fill(0);
         sendData.fill(0);
+        sendFilePath.fill(0);
+        receiveFilePath.fill(0);
 
         strcpy(sendData.data(), "Sample Data");
     }
 
     inline float getHzPerFrame() const { return ((double)(sampleRate))/samplesPerFrame; }
+    inline int getTonesPerTx() const {
+        if (modulation == Mod_DPSK) return nDataBitsPerTx;
+        if (modulation == Mod_OFDM) return getOFDMCarriers();
+        return nDataBitsPerTx/nBitsPerTone;
+    }
+    // QPSK data carriers plus one pilot every kOFDMPilotSpacing carriers
+    inline int getOFDMCarriers() const {
+        int nData = nDataBitsPerTx/2;
+        return nData + (nData + Constants::kOFDMPilotSpacing - 2)/(Constants::kOFDMPilotSpacing - 1);
+    }
+    inline float getDataBandwidth_hz() const {
+        return (modulation == Mod_OFDM) ? getOFDMCarriers()*getHzPerFrame() : getTonesPerTx()*freqDelta_hz;
+    }
+    inline float getFreqDeltaChecksum_hz() const { return std::max(freqDelta_hz, 2*getHzPerFrame()); }
 
     static const char * configNames[];
+    static const char * rampShapeNames[];
+    static const char * modulationNames[];
     static StateInput getDefaultConfig(ConfigId cid);
 
+    static const RateStep rateLadder[Constants::kRateLadderSize];
+    static int getRateStepId(ConfigId cid);
+
+    ConfigId configId = BW16_Stable;
+
     int sampleRate = Constants::kDefaultSamplingRate;
     int samplesPerFrame = Constants::kMaxSamplesPerFrame;
     int samplesPerSubFrame = samplesPerFrame/Constants::kSubFrames;
     int nRampFramesBegin = 16*Constants::kFactor;
     int nRampFramesEnd = 16*Constants::kFactor;
     int nRampFramesBlend = 16*Constants::kFactor;
+    RampShape rampShape = Ramp_RaisedCosine;
     int nConfirmFrames = 1;
     int subFramesPerTx = 64*Constants::kFactor;
     int nDataBitsPerTx = 64*Constants::kFactor;
     int nECCBytesPerTx = 4;
+    int nBitsPerTone = 1;
+    Modulation modulation = Mod_FSK;
+    int nCyclicPrefix = 256;
 
     bool encodeIdParity = true;
     bool useChecksum = false;
+    bool usePAPRReduction = true;
+
+    // LZSS back-references span chunks - without framing a lost chunk garbles the rest of the stream
+    bool useCompression = false;
+    bool useRateAdaptation = false;
+
+    // RS codewords across a block of Tx - byte b of every Tx in the block belongs to codeword b
+    bool useInterleaving = false;
+    int nTxPerBlock = 32;
+    int nParityTxPerBlock = 4;
+
+    // rateless broadcast - every generation of chunks is sent as an endless run of encoded symbols,
+    // of which at least (1 + fountainOverhead) per chunk before moving on to the rest of the data
+    bool useFountain = false;
+    float fountainOverhead = 1.0f;
+
+    // K=7 rate 1/2 convolutional code under the RS code of every Tx, decoded from the soft detector margins
+    bool useInnerCode = false;
+
+    // frames with a start-of-message flag and a sequence number, every message ends with its length and CRC-32
+    bool useFraming = false;
+
+    // selective-repeat ARQ over the frames - the receiver acknowledges on a band above the checksum tones
+    bool useArq = false;
 
     float sendVolume = 0.1f;
     float sendDuration_ms = 100.0f;
@@ -78,7 +160,37 @@ struct StateInput {
     float freqCheck_hz = 360*getHzPerFrame();
 
     std::array<bool, Constants::kMaxDataBits> dataBits;
-    std::array<char, Constants::kMaxDataSize> sendData;
+    SendData sendData;
+
+    std::array<char, Constants::kMaxFilePath> sendFilePath;
+    std::array<char, Constants::kMaxFilePath> receiveFilePath;
+};
+
+struct LinkQuality {
+    float snr_dB = 0.0f;
+    float eccUsage = 0.0f;
+    int nFrames = 0;
+    int nFailures = 0;
+    int recommendedStepId = -1;
+};
+
+// Snapshots come from small pools of the worker and are never modified once published.
+// The version grows with every snapshot of the same kind.
+struct FrameSnapshot {
+    int version = 0;
+    AmplitudeData sampleAmplitude;
+    SpectrumData sampleSpectrum;
+    SpectrumData historySpectrumAverage;
+};
+
+struct ToneSnapshot {
+    int version = 0;
+    std::array<AmplitudeData, Constants::kMaxDataBits> bitAmplitude;
+};
+
+struct ReceivedSnapshot {
+    int version = 0;
+    std::array<char, Constants::kMaxDataSize> receivedData;
 };
 
 struct StateData {
@@ -91,11 +203,21 @@ struct StateData {
     bool sendingDataBuffer = false;
     bool receivingData = false;
 
-    AmplitudeData * sampleAmplitude = nullptr;
-    SpectrumData * sampleSpectrum = nullptr;
-    SpectrumData * historySpectrumAverage = nullptr;
-    std::array<AmplitudeData, Constants::kMaxDataBits> * bitAmplitude = nullptr;
-
-    std::array<char, Constants::kMaxDataSize> * receivedData = nullptr;
+    int nQueuedMessages = 0;
+    int nBytesSent = 0;
+    int nBytesReceived = 0;
+    int nMessagesReceived = 0;
+    int nMessagesCorrupted = 0;
+    int nRetransmissions = 0;
+
+    // rateStepId is the ladder step both ends have agreed to switch to, announced by incrementing nRateChanges
+    LinkQuality linkQuality;
+    int rateStepId = -1;
+    int nRateChanges = 0;
+
+    // immutable snapshots published by the worker - null until the audio is initialized
+    std::shared_ptr<const FrameSnapshot> frame;
+    std::shared_ptr<const ToneSnapshot> tones;
+    std::shared_ptr<const ReceivedSnapshot> received;
 };
 }
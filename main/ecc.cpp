@@ -0,0 +1,40 @@
+/*! \file ecc.cpp
+ *  \brief Reed-Solomon codecs for the (message, ECC) sizes of the protocol profiles
+ *  \author Georgi Gerganov
+ */
+
+#include "ecc.h"
+
+namespace {
+    template<int Msg, int Ecc>
+    std::shared_ptr<RS::Codec> makeFixedCodec() {
+        return std::make_shared<RS::FixedCodec<Msg, Ecc>>();
+    }
+
+    struct CodecEntry {
+        int nMsgBytes;
+        int nECCBytes;
+        std::shared_ptr<RS::Codec> (*create)();
+    };
+
+    // bytes per Tx minus the 4 ECC bytes of the profiles in StateInput::getDefaultConfig
+    const CodecEntry kFixedCodecs[] = {
+        {  2, 4, &makeFixedCodec< 2, 4> },
+        {  4, 4, &makeFixedCodec< 4, 4> },
+        {  5, 4, &makeFixedCodec< 5, 4> },
+        {  8, 4, &makeFixedCodec< 8, 4> },
+        { 12, 4, &makeFixedCodec<12, 4> },
+        { 20, 4, &makeFixedCodec<20, 4> },
+        { 28, 4, &makeFixedCodec<28, 4> },
+    };
+}
+
+std::shared_ptr<RS::Codec> makeReedSolomon(int nMsgBytes, int nECCBytes) {
+    for (const auto & entry : kFixedCodecs) {
+        if (entry.nMsgBytes == nMsgBytes && entry.nECCBytes == nECCBytes) {
+            return entry.create();
+        }
+    }
+
+    return std::make_shared<RS::RuntimeCodec>(nMsgBytes, nECCBytes);
+}
@@ -0,0 +1,13 @@
+/*! \file ecc.h
+ *  \brief Reed-Solomon codecs for the (message, ECC) sizes of the protocol profiles
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include "reed-solomon/codec.hpp"
+
+#include <memory>
+
+// compile-time specialized codec when the sizes are in the dispatch table, runtime codec otherwise
+std::shared_ptr<RS::Codec> makeReedSolomon(int nMsgBytes, int nECCBytes);
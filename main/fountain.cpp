@@ -0,0 +1,150 @@
+/*! \file fountain.cpp
+ *  \brief Systematic random linear fountain code for the one-to-many broadcast mode
+ *  \author Georgi Gerganov
+ */
+
+#include "fountain.h"
+
+#include <algorithm>
+
+namespace {
+    // counter-based hash generator - a linear one (e.g. xorshift) would make the symbols linearly dependent
+    struct Random {
+        std::uint32_t state;
+
+        explicit Random(std::uint32_t seed) : state(seed) {}
+
+        std::uint32_t next() {
+            std::uint32_t z = (state += 0x9e3779b9u);
+            z = (z ^ (z >> 16))*0x85ebca6bu;
+            z = (z ^ (z >> 13))*0xc2b2ae35u;
+            return z ^ (z >> 16);
+        }
+    };
+
+    inline void xorBytes(const std::uint8_t * src, std::uint8_t * dst, int n) {
+        for (int i = 0; i < n; ++i) {
+            dst[i] ^= src[i];
+        }
+    }
+}
+
+void FountainCode::init(int nSymbols, int symbolSize) {
+    _nSymbols = nSymbols;
+    _symbolSize = symbolSize;
+}
+
+void FountainCode::getNeighbours(int symbolId, std::vector<int> & neighbours) const {
+    neighbours.clear();
+    if (_nSymbols <= 0) return;
+
+    if (symbolId < _nSymbols) {
+        neighbours.push_back(symbolId);
+        return;
+    }
+
+    // every source symbol with probability 1/2, at least one of them
+    Random rng(((std::uint32_t) _nSymbols << 16) ^ (std::uint32_t) symbolId);
+    std::uint32_t bits = 0;
+    for (int i = 0; i < _nSymbols; ++i) {
+        if (i%32 == 0) bits = rng.next();
+        if (bits & 1) neighbours.push_back(i);
+        bits >>= 1;
+    }
+    if (neighbours.empty()) neighbours.push_back(rng.next() % _nSymbols);
+}
+
+void FountainEncoder::init(const std::uint8_t * src, int nSymbols, int symbolSize) {
+    _code.init(nSymbols, symbolSize);
+    _source.assign(src, src + nSymbols*symbolSize);
+}
+
+void FountainEncoder::encode(int symbolId, std::uint8_t * dst) {
+    int n = _code.getSymbolSize();
+    std::fill(dst, dst + n, 0);
+
+    _code.getNeighbours(symbolId, _neighbours);
+    for (int id : _neighbours) {
+        ::xorBytes(_source.data() + id*n, dst, n);
+    }
+}
+
+void FountainDecoder::init(int nSymbols, int symbolSize) {
+    _code.init(nSymbols, symbolSize);
+    _nSymbols = nSymbols;
+    _nWords = (nSymbols + 63)/64;
+    _rank = 0;
+    _nReceived = 0;
+
+    _mask.assign(nSymbols*_nWords, 0);
+    _data.assign(nSymbols*symbolSize, 0);
+    _hasRow.assign(nSymbols, false);
+    _seen.assign(kFountainSymbolIds, false);
+
+    _rowMask.resize(_nWords);
+    _rowData.resize(symbolSize);
+}
+
+bool FountainDecoder::add(int symbolId, const std::uint8_t * symbol) {
+    if (_nSymbols <= 0 || isComplete()) return isComplete();
+    if (symbolId < 0 || symbolId >= kFountainSymbolIds || _seen[symbolId]) return false;
+
+    _seen[symbolId] = true;
+    ++_nReceived;
+
+    int n = _code.getSymbolSize();
+
+    std::fill(_rowMask.begin(), _rowMask.end(), 0);
+    _code.getNeighbours(symbolId, _neighbours);
+    for (int id : _neighbours) {
+        _rowMask[id/64] |= (std::uint64_t) 1 << (id%64);
+    }
+    std::copy(symbol, symbol + n, _rowData.begin());
+
+    // eliminate the lowest set column until it has no row yet - then the symbol becomes that row
+    int w = 0;
+    while (true) {
+        while (w < _nWords && _rowMask[w] == 0) ++w;
+        if (w == _nWords) return false;
+
+        std::uint64_t bits = _rowMask[w];
+        int c = w*64;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            ++c;
+        }
+
+        if (_hasRow[c] == false) {
+            std::copy(_rowMask.begin(), _rowMask.end(), _mask.begin() + c*_nWords);
+            std::copy(_rowData.begin(), _rowData.end(), _data.begin() + c*n);
+            _hasRow[c] = true;
+            ++_rank;
+            break;
+        }
+
+        const std::uint64_t * row = _mask.data() + c*_nWords;
+        for (int i = w; i < _nWords; ++i) {
+            _rowMask[i] ^= row[i];
+        }
+        ::xorBytes(_data.data() + c*n, _rowData.data(), n);
+    }
+
+    if (isComplete()) solve();
+
+    return isComplete();
+}
+
+// back substitution - every row is upper triangular, clear the columns above its pivot from the bottom up
+void FountainDecoder::solve() {
+    int n = _code.getSymbolSize();
+
+    for (int c = _nSymbols - 1; c >= 0; --c) {
+        std::uint64_t * row = _mask.data() + c*_nWords;
+        for (int j = c + 1; j < _nSymbols; ++j) {
+            if ((row[j/64] >> (j%64)) & 1) {
+                ::xorBytes(_data.data() + j*n, _data.data() + c*n, n);
+                row[j/64] ^= (std::uint64_t) 1 << (j%64);
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*! \file fountain.h
+ *  \brief Systematic random linear fountain code for the one-to-many broadcast mode
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// A generation of K equally sized source symbols gives an endless sequence of encoded symbols.
+// Symbol ids 0 .. K-1 are the source symbols themselves, every later one is the XOR of a
+// pseudo-random half of the source symbols that both ends derive from K and the symbol id alone.
+// With at most kMaxFountainSymbols per generation dense combinations are cheap, and unlike the
+// sparse LT degree distributions they need only a couple of symbols beyond K to decode.
+
+constexpr int kMaxFountainSymbols = 255;
+
+// symbol ids are 12-bit on the air - the sender wraps around after the last one
+constexpr int kFountainSymbolIds = 4096;
+
+class FountainCode {
+public:
+    void init(int nSymbols, int symbolSize);
+
+    int getNumSymbols() const { return _nSymbols; }
+    int getSymbolSize() const { return _symbolSize; }
+
+    // source symbols that make up encoded symbol symbolId
+    void getNeighbours(int symbolId, std::vector<int> & neighbours) const;
+
+private:
+    int _nSymbols = 0;
+    int _symbolSize = 0;
+};
+
+class FountainEncoder {
+public:
+    // src holds nSymbols*symbolSize bytes
+    void init(const std::uint8_t * src, int nSymbols, int symbolSize);
+
+    int getNumSymbols() const { return _code.getNumSymbols(); }
+    int getSymbolSize() const { return _code.getSymbolSize(); }
+
+    void encode(int symbolId, std::uint8_t * dst);
+
+private:
+    FountainCode _code;
+    std::vector<std::uint8_t> _source;
+    std::vector<int> _neighbours;
+};
+
+// Maximum-likelihood decoding: every received symbol is an equation over GF(2) and is eliminated
+// against the ones before it, so a generation completes as soon as K independent symbols are in
+class FountainDecoder {
+public:
+    void init(int nSymbols, int symbolSize);
+
+    int getNumSymbols() const { return _code.getNumSymbols(); }
+    int getSymbolSize() const { return _code.getSymbolSize(); }
+
+    // returns true once every source symbol is known - repeated symbol ids are ignored
+    bool add(int symbolId, const std::uint8_t * symbol);
+
+    bool isComplete() const { return _nSymbols > 0 && _rank == _nSymbols; }
+    int getNumKnown() const { return _rank; }
+    int getNumReceived() const { return _nReceived; }
+
+    // the source symbols back to back, valid once complete
+    const std::uint8_t * getSource() const { return _data.data(); }
+
+private:
+    void solve();
+
+    FountainCode _code;
+    int _nSymbols = 0;
+    int _nWords = 0;
+    int _rank = 0;
+    int _nReceived = 0;
+
+    // row c of the echelon form has its lowest set bit at column c
+    std::vector<std::uint64_t> _mask;
+    std::vector<std::uint8_t> _data;
+    std::vector<bool> _hasRow;
+    std::vector<bool> _seen;
+
+    std::vector<int> _neighbours;
+    std::vector<std::uint64_t> _rowMask;
+    std::vector<std::uint8_t> _rowData;
+};
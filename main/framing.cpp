@@ -0,0 +1,159 @@
+/*! \file framing.cpp
+ *  \brief Framed packet layer - start of message, sequence numbers and a length / CRC-32 trailer
+ *  \author Georgi Gerganov
+ */
+
+#include "framing.h"
+
+#include <algorithm>
+
+namespace {
+    struct CRCTable {
+        std::uint32_t value[256];
+
+        CRCTable() {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+                }
+                value[i] = c;
+            }
+        }
+    };
+
+    const CRCTable & getCRCTable() {
+        static const CRCTable table;
+        return table;
+    }
+
+    inline void writeU32(std::uint8_t * dst, std::uint32_t x) {
+        for (int i = 0; i < 4; ++i) {
+            dst[i] = (x >> (8*i)) & 0xFF;
+        }
+    }
+
+    inline std::uint32_t readU32(const std::uint8_t * src) {
+        std::uint32_t x = 0;
+        for (int i = 0; i < 4; ++i) {
+            x |= ((std::uint32_t) src[i]) << (8*i);
+        }
+        return x;
+    }
+}
+
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t * src, int n) {
+    const auto & table = getCRCTable();
+
+    crc = ~crc;
+    for (int i = 0; i < n; ++i) {
+        crc = table.value[(crc ^ src[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void FrameEncoder::startMessage() {
+    _isStart = true;
+    _isSourceEnd = false;
+    _trailerPos = 0;
+    _length = 0;
+    _crc = 0;
+}
+
+int FrameEncoder::encode(const Reader & read, std::uint8_t * dst, int frameSize) {
+    int nPayload = frameSize - kFrameHeaderSize;
+    std::uint8_t * payload = dst + kFrameHeaderSize;
+    std::fill(dst, dst + frameSize, 0);
+
+    int n = 0;
+    int nRead = 0;
+    while (n < nPayload && isMessageEnd() == false) {
+        if (_isSourceEnd == false) {
+            int res = read ? read(payload + n, nPayload - n) : 0;
+            if (res > 0) {
+                _crc = ::crc32(_crc, payload + n, res);
+                _length += res;
+                n += res;
+                nRead += res;
+                continue;
+            }
+
+            _isSourceEnd = true;
+            ::writeU32(_trailer, _length);
+            ::writeU32(_trailer + 4, _crc);
+        }
+
+        int m = std::min(nPayload - n, kFrameTrailerSize - _trailerPos);
+        std::copy(_trailer + _trailerPos, _trailer + _trailerPos + m, payload + n);
+        _trailerPos += m;
+        n += m;
+    }
+
+    dst[0] = n | (isMessageEnd() ? kFrameEndOfMessage : 0);
+    dst[1] = _seq | (_isStart ? kFrameStartOfMessage : 0);
+
+    _isStart = false;
+    _seq = (_seq + 1) % kFrameSeqCount;
+
+    return nRead;
+}
+
+void FrameDecoder::reset() {
+    _lastSeq = -1;
+    _isInMessage = false;
+    _pending.clear();
+}
+
+FrameInfo FrameDecoder::add(const std::uint8_t * frame, int frameSize, std::vector<std::uint8_t> & out) {
+    FrameInfo info;
+
+    int seq = frame[1] & kFrameSeqMask;
+    if (seq == _lastSeq) {
+        info.isRepeat = true;
+        return info;
+    }
+
+    bool isNext = _lastSeq >= 0 && seq == (_lastSeq + 1) % kFrameSeqCount;
+    _lastSeq = seq;
+
+    info.isStart = (frame[1] & kFrameStartOfMessage) != 0;
+    if (info.isStart) {
+        // the previous message never got its last frame
+        info.isLost = _isInMessage;
+
+        _isInMessage = true;
+        _length = 0;
+        _crc = 0;
+        _pending.clear();
+    } else if (_isInMessage == false) {
+        // the start of this message was missed
+        return info;
+    } else if (isNext == false) {
+        info.isLost = true;
+        _isInMessage = false;
+        return info;
+    }
+
+    info.isAccepted = true;
+    info.isEnd = (frame[0] & kFrameEndOfMessage) != 0;
+
+    int n = std::min(frame[0] & kFrameSizeMask, frameSize - kFrameHeaderSize);
+    _pending.insert(_pending.end(), frame + kFrameHeaderSize, frame + kFrameHeaderSize + n);
+
+    int nRelease = std::max(0, (int) _pending.size() - kFrameTrailerSize);
+    if (nRelease > 0) {
+        _crc = ::crc32(_crc, _pending.data(), nRelease);
+        _length += nRelease;
+        out.insert(out.end(), _pending.begin(), _pending.begin() + nRelease);
+        _pending.erase(_pending.begin(), _pending.begin() + nRelease);
+    }
+
+    if (info.isEnd) {
+        info.isValid = (int) _pending.size() == kFrameTrailerSize &&
+            ::readU32(_pending.data()) == _length && ::readU32(_pending.data() + 4) == _crc;
+        _isInMessage = false;
+        _pending.clear();
+    }
+
+    return info;
+}
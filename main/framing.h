@@ -0,0 +1,79 @@
+/*! \file framing.h
+ *  \brief Framed packet layer - start of message, sequence numbers and a length / CRC-32 trailer
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// Frame: [payload size | end-of-message][start-of-message | sequence number][payload]
+// The payload of the frames of a message is the message followed by an 8-byte trailer: its length and
+// its CRC-32, little endian. The first byte has the layout of a plain chunk header.
+
+constexpr std::uint8_t kFrameSizeMask = 0x7F;
+constexpr std::uint8_t kFrameEndOfMessage = 0x80;
+constexpr std::uint8_t kFrameSeqMask = 0x7F;
+constexpr std::uint8_t kFrameStartOfMessage = 0x80;
+
+constexpr int kFrameHeaderSize = 2;
+constexpr int kFrameTrailerSize = 8;
+constexpr int kFrameSeqCount = 128;
+
+// running CRC-32 (IEEE 802.3) - start with 0
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t * src, int n);
+
+class FrameEncoder {
+public:
+    // pulls up to n message bytes into dst and returns how many were written - 0 ends the message
+    using Reader = std::function<int(std::uint8_t * dst, int n)>;
+
+    // the next frame starts a new message
+    void startMessage();
+
+    // fills a frame of frameSize bytes and returns the number of message bytes in it
+    int encode(const Reader & read, std::uint8_t * dst, int frameSize);
+
+    // the last frame carried the end of the trailer
+    bool isMessageEnd() const { return _trailerPos == kFrameTrailerSize; }
+
+private:
+    bool _isStart = true;
+    bool _isSourceEnd = false;
+    int _seq = 0;
+    int _trailerPos = 0;
+    std::uint32_t _length = 0;
+    std::uint32_t _crc = 0;
+    std::uint8_t _trailer[kFrameTrailerSize];
+};
+
+struct FrameInfo {
+    bool isRepeat = false;      // same sequence number as the previous frame
+    bool isLost = false;        // the message in progress misses frames and is dropped
+    bool isAccepted = false;    // the frame belongs to the current message
+    bool isStart = false;
+    bool isEnd = false;
+    bool isValid = false;       // at the end - the length and the CRC-32 of the message match its trailer
+};
+
+// The last kFrameTrailerSize payload bytes are held back until the next frame - they are the trailer
+// if the message ends before that
+class FrameDecoder {
+public:
+    void reset();
+
+    // the message bytes released by the frame are appended to out
+    FrameInfo add(const std::uint8_t * frame, int frameSize, std::vector<std::uint8_t> & out);
+
+    bool isInMessage() const { return _isInMessage; }
+    int getMessageLength() const { return _length; }
+
+private:
+    int _lastSeq = -1;
+    bool _isInMessage = false;
+    std::uint32_t _length = 0;
+    std::uint32_t _crc = 0;
+    std::vector<std::uint8_t> _pending;
+};
@@ -0,0 +1,592 @@
+/*! \file ofdm.cpp
+ *  \brief OFDM modem with cyclic prefix and pilot-based equalization
+ *  \author Georgi Gerganov
+ */
+
+#include "ofdm.h"
+
+#include "data.h"
+
+#include "fftw3.h"
+
+#include <cmath>
+#include <complex>
+#include <algorithm>
+
+namespace {
+    using TComplex = std::complex<float>;
+
+    // Schmidl-Cox metric threshold and minimum average power of a valid training symbol
+    const float kSyncThreshold = 0.6f;
+    const float kSyncMinPower = 1e-8f;
+
+    // longest packet the header is allowed to announce
+    const int kMaxSymbolsPerPacket = 4096;
+
+    // header word: symbol count and its complement, one bit per data carrier
+    const int kHeaderBits = 32;
+
+    // the metric accumulators are recomputed from scratch this often to bound rounding drift
+    const int kMetricRefreshPeriod = 4096;
+
+    // length of the fade-in/out applied at the packet edges
+    const int kEdgeRampSamples = 32;
+
+    // clip-and-filter: clipping level relative to the RMS of the symbol and number of passes
+    const float kClipRatio = 1.8f;
+    const int kClipIterations = 4;
+
+    // pseudo-random +-1 sequence shared by the transmitter and the receiver
+    class Sequence {
+    public:
+        explicit Sequence(uint32_t seed) : _state(seed) {}
+        float next() {
+            _state = _state*1664525u + 1013904223u;
+            return (_state >> 31) ? -1.0f : 1.0f;
+        }
+    private:
+        uint32_t _state;
+    };
+}
+
+struct OFDM::Data {
+    enum State {
+        Searching,
+        Training,
+        Header,
+        Payload,
+    };
+
+    bool initialized = false;
+
+    int N = 0;
+    int L = 0;
+    int nCyclicPrefix = 0;
+    int binStart = 0;
+    int binEnd = 0;
+    int nBitsPerSymbol = 0;
+    int nBytesPerSymbol = 0;
+    bool reducePAPR = false;
+
+    std::vector<int> dataBins;
+    std::vector<int> pilotBins;
+    std::vector<float> pilotValues;
+
+    // training symbol value for every bin in [binStart, binEnd), zero on odd bins
+    std::vector<TComplex> trainingValues;
+
+    // the header bits are repeated over the data carriers - scrambling them avoids a periodic, peaky symbol
+    std::vector<float> headerScrambler;
+
+    std::vector<TComplex> spectrum;
+
+    float * timeBuffer = nullptr;
+    fftwf_complex * freqBuffer = nullptr;
+    fftwf_plan planForward = nullptr;
+    fftwf_plan planBackward = nullptr;
+
+    // receiver
+    State state = Searching;
+
+    std::vector<float> rx;
+    long long rxOffset = 0;
+
+    long long searchPos = 0;
+    bool metricValid = false;
+    int metricAge = 0;
+    double metricP = 0.0;
+    double metricR = 0.0;
+    long long plateauStart = -1;
+    long long plateauEnd = -1;
+
+    long long symbolStart = 0;
+    int nSymbols = 0;
+    int symbolId = 0;
+
+    std::vector<TComplex> channel;
+    std::vector<TComplex> equalized;
+    std::vector<std::uint8_t> symbolData;
+    float snr_dB = 0.0f;
+
+    void free() {
+        if (planForward) fftwf_destroy_plan(planForward);
+        if (planBackward) fftwf_destroy_plan(planBackward);
+        if (timeBuffer) fftwf_free(timeBuffer);
+        if (freqBuffer) fftwf_free(freqBuffer);
+
+        planForward = nullptr;
+        planBackward = nullptr;
+        timeBuffer = nullptr;
+        freqBuffer = nullptr;
+
+        initialized = false;
+    }
+
+    inline float sample(long long i) const { return rx[i - rxOffset]; }
+    inline long long rxEnd() const { return rxOffset + (long long) rx.size(); }
+
+    void clearSpectrum() {
+        for (int i = 0; i <= N/2; ++i) {
+            freqBuffer[i][0] = 0.0f;
+            freqBuffer[i][1] = 0.0f;
+        }
+    }
+
+    void setBin(int bin, TComplex v) {
+        freqBuffer[bin][0] = v.real();
+        freqBuffer[bin][1] = v.imag();
+    }
+
+    void appendSymbol(std::vector<float> & samples) {
+        fftwf_execute(planBackward);
+
+        for (int i = N - nCyclicPrefix; i < N; ++i) samples.push_back(timeBuffer[i]);
+        for (int i = 0; i < N; ++i) samples.push_back(timeBuffer[i]);
+    }
+
+    // clip the time-domain symbol and remove the resulting out-of-band and pilot distortion
+    void clipAndFilter() {
+        spectrum.resize(N/2 + 1);
+        for (int i = 0; i <= N/2; ++i) spectrum[i] = TComplex(freqBuffer[i][0], freqBuffer[i][1]);
+
+        const float iN = 1.0f/N;
+        for (int iter = 0; iter < kClipIterations; ++iter) {
+            for (int i = 0; i <= N/2; ++i) setBin(i, spectrum[i]);
+            fftwf_execute(planBackward);
+
+            float sum2 = 0.0f;
+            for (int i = 0; i < N; ++i) sum2 += timeBuffer[i]*timeBuffer[i];
+            float level = kClipRatio*std::sqrt(sum2*iN);
+            for (int i = 0; i < N; ++i) timeBuffer[i] = std::max(-level, std::min(level, timeBuffer[i]));
+
+            fftwf_execute(planForward);
+            for (int i = 0; i <= N/2; ++i) {
+                if (i < binStart || i >= binEnd) {
+                    spectrum[i] = 0.0f;
+                } else {
+                    spectrum[i] = iN*TComplex(freqBuffer[i][0], freqBuffer[i][1]);
+                }
+            }
+            for (int i = 0; i < (int) pilotBins.size(); ++i) spectrum[pilotBins[i]] = pilotValues[i];
+        }
+
+        for (int i = 0; i <= N/2; ++i) setBin(i, spectrum[i]);
+    }
+
+    void setPilots() {
+        for (int i = 0; i < (int) pilotBins.size(); ++i) setBin(pilotBins[i], pilotValues[i]);
+    }
+
+    void analyzeSymbol(long long start) {
+        for (int i = 0; i < N; ++i) timeBuffer[i] = sample(start + i);
+        fftwf_execute(planForward);
+    }
+
+    void equalize() {
+        for (int bin = binStart; bin < binEnd; ++bin) {
+            TComplex y(freqBuffer[bin][0], freqBuffer[bin][1]);
+            TComplex h = channel[bin - binStart];
+            equalized[bin - binStart] = (std::norm(h) > 0.0f) ? y/h : TComplex(0.0f);
+        }
+
+        // residual phase since the training symbol: common offset plus a linear ramp from sampling clock drift
+        int nPilots = pilotBins.size();
+        float slope = 0.0f;
+        if (nPilots > 1) {
+            TComplex acc(0.0f);
+            for (int i = 1; i < nPilots; ++i) {
+                TComplex z0 = equalized[pilotBins[i - 1] - binStart]*pilotValues[i - 1];
+                TComplex z1 = equalized[pilotBins[i] - binStart]*pilotValues[i];
+                acc += z1*std::conj(z0);
+            }
+            slope = std::arg(acc)/::Data::Constants::kOFDMPilotSpacing;
+        }
+
+        TComplex acc(0.0f);
+        for (int i = 0; i < nPilots; ++i) {
+            TComplex z = equalized[pilotBins[i] - binStart]*pilotValues[i];
+            acc += z*std::polar(1.0f, -slope*(pilotBins[i] - binStart));
+        }
+        float phase = std::arg(acc);
+
+        for (int bin = binStart; bin < binEnd; ++bin) {
+            equalized[bin - binStart] *= std::polar(1.0f, -phase - slope*(bin - binStart));
+        }
+    }
+
+    void estimateChannel() {
+        for (int bin = binStart; bin < binEnd; bin += 1) {
+            if (trainingValues[bin - binStart] == TComplex(0.0f)) continue;
+            TComplex y(freqBuffer[bin][0], freqBuffer[bin][1]);
+            channel[bin - binStart] = y/trainingValues[bin - binStart];
+        }
+
+        // odd bins carry no training energy - interpolate from the neighbours
+        for (int bin = binStart; bin < binEnd; bin += 1) {
+            if (trainingValues[bin - binStart] != TComplex(0.0f)) continue;
+            bool hasPrev = bin - 1 >= binStart;
+            bool hasNext = bin + 1 < binEnd;
+            if (hasPrev && hasNext) {
+                channel[bin - binStart] = 0.5f*(channel[bin - 1 - binStart] + channel[bin + 1 - binStart]);
+            } else if (hasPrev) {
+                channel[bin - binStart] = channel[bin - 1 - binStart];
+            } else if (hasNext) {
+                channel[bin - binStart] = channel[bin + 1 - binStart];
+            }
+        }
+    }
+
+    bool decodeHeader(int & count) {
+        equalize();
+
+        float soft[kHeaderBits];
+        std::fill(soft, soft + kHeaderBits, 0.0f);
+        for (int d = 0; d < (int) dataBins.size(); ++d) {
+            const TComplex & z = equalized[dataBins[d] - binStart];
+            soft[d%kHeaderBits] += headerScrambler[d]*(z.real() + z.imag());
+        }
+
+        uint32_t value = 0;
+        for (int b = 0; b < kHeaderBits; ++b) {
+            if (soft[b] < 0.0f) value |= (1u << b);
+        }
+
+        count = value & 0xFFFF;
+        int check = (~value >> 16) & 0xFFFF;
+
+        return count == check && count > 0 && count <= kMaxSymbolsPerPacket;
+    }
+
+    void decodePayload() {
+        equalize();
+
+        std::fill(symbolData.begin(), symbolData.end(), 0);
+        float amplitude = 0.0f;
+        for (int d = 0; d < (int) dataBins.size(); ++d) {
+            const TComplex & z = equalized[dataBins[d] - binStart];
+            int bit = 2*d;
+            if (z.real() < 0.0f) symbolData[bit/8] |= (1 << (bit%8));
+            ++bit;
+            if (z.imag() < 0.0f) symbolData[bit/8] |= (1 << (bit%8));
+            amplitude += std::fabs(z.real()) + std::fabs(z.imag());
+        }
+
+        // error vector magnitude with respect to the nearest QPSK point
+        int nData = std::max(1, (int) dataBins.size());
+        amplitude /= 2*nData;
+        float error = 0.0f;
+        for (int d = 0; d < (int) dataBins.size(); ++d) {
+            const TComplex & z = equalized[dataBins[d] - binStart];
+            TComplex ref(std::copysign(amplitude, z.real()), std::copysign(amplitude, z.imag()));
+            error += std::norm(z - ref);
+        }
+        error /= nData;
+        snr_dB = 10.0f*std::log10((2*amplitude*amplitude + 1e-12f)/(error + 1e-12f));
+    }
+
+    // advance the Schmidl-Cox search by one sample, returns true when a training symbol has been located
+    bool searchStep() {
+        long long d = searchPos;
+
+        if (metricValid == false || metricAge >= kMetricRefreshPeriod) {
+            metricP = 0.0;
+            metricR = 0.0;
+            for (int m = 0; m < L; ++m) {
+                float a = sample(d + m);
+                float b = sample(d + m + L);
+                metricP += a*b;
+                metricR += b*b;
+            }
+            metricValid = true;
+            metricAge = 0;
+        } else {
+            float a = sample(d - 1);
+            float b = sample(d + L - 1);
+            float c = sample(d + 2*L - 1);
+            metricP += b*c - a*b;
+            metricR += c*c - b*b;
+            ++metricAge;
+        }
+
+        ++searchPos;
+
+        bool above = false;
+        if (metricP > 0.0 && metricR > kSyncMinPower*L) {
+            double m = (metricP*metricP)/(metricR*metricR);
+            above = m > kSyncThreshold;
+        }
+
+        if (above) {
+            if (plateauStart < 0) plateauStart = d;
+            plateauEnd = d;
+            return false;
+        }
+
+        if (plateauStart >= 0) {
+            long long start = plateauStart;
+            long long end = plateauEnd;
+            plateauStart = -1;
+            plateauEnd = -1;
+
+            if (end - start >= nCyclicPrefix/2) {
+                // middle of the plateau leaves equal margin for timing error and channel delay spread
+                symbolStart = (start + end)/2;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void restartSearch(long long pos) {
+        state = Searching;
+        searchPos = std::max(pos, rxOffset);
+        metricValid = false;
+        plateauStart = -1;
+        plateauEnd = -1;
+    }
+
+    void trim() {
+        long long keep = (state == Searching) ? searchPos - 1 : symbolStart;
+        long long n = std::min(keep, rxEnd()) - rxOffset;
+        if (n > 4*N) {
+            rx.erase(rx.begin(), rx.begin() + n);
+            rxOffset += n;
+        }
+    }
+};
+
+OFDM::OFDM() : _data(new Data()) {}
+
+OFDM::~OFDM() {
+    _data->free();
+}
+
+bool OFDM::init(const Parameters & params) {
+    auto & data = *_data;
+
+    data.free();
+
+    if (params.samplesPerFrame < 16 || params.samplesPerFrame % 2 != 0) return false;
+    if (params.nCyclicPrefix < 0 || params.nCyclicPrefix > params.samplesPerFrame/2) return false;
+    if (params.nBitsPerSymbol <= 0 || params.nBitsPerSymbol % 16 != 0) return false;
+
+    // two bits per data carrier - the whole header word needs a carrier per bit
+    if (params.nBitsPerSymbol/2 < kHeaderBits) return false;
+
+    data.N = params.samplesPerFrame;
+    data.L = data.N/2;
+    data.nCyclicPrefix = params.nCyclicPrefix;
+    data.binStart = params.binStart;
+    data.nBitsPerSymbol = params.nBitsPerSymbol;
+    data.nBytesPerSymbol = params.nBitsPerSymbol/8;
+    data.reducePAPR = params.reducePAPR;
+
+    data.dataBins.clear();
+    data.pilotBins.clear();
+    data.pilotValues.clear();
+
+    int nDataCarriers = data.nBitsPerSymbol/2;
+    int carrier = data.binStart;
+    Sequence pilotSequence(0x2545F491u);
+    while ((int) data.dataBins.size() < nDataCarriers) {
+        if ((carrier - data.binStart) % ::Data::Constants::kOFDMPilotSpacing == 0) {
+            data.pilotBins.push_back(carrier);
+            data.pilotValues.push_back(pilotSequence.next());
+        } else {
+            data.dataBins.push_back(carrier);
+        }
+        ++carrier;
+    }
+    data.binEnd = carrier;
+
+    if (data.binStart < 1 || data.binEnd >= data.N/2) return false;
+
+    int nBins = data.binEnd - data.binStart;
+    int nTrainingBins = (data.binEnd - data.binStart + 1)/2;
+    data.trainingValues.assign(nBins, 0.0f);
+    for (int bin = data.binStart, m = 0; bin < data.binEnd; ++bin) {
+        // only even bins, so that the two halves of the symbol are identical
+        if (bin%2 != 0) continue;
+        // Newman phases keep the peak of the known symbol low
+        data.trainingValues[bin - data.binStart] = std::polar(std::sqrt(2.0f), (float) M_PI*m*m/nTrainingBins);
+        ++m;
+    }
+
+    data.headerScrambler.resize(data.dataBins.size());
+    Sequence headerSequence(0x9E3779B9u);
+    for (auto & v : data.headerScrambler) v = headerSequence.next();
+
+    data.channel.assign(nBins, 0.0f);
+    data.equalized.assign(nBins, 0.0f);
+    data.symbolData.assign(data.nBytesPerSymbol, 0);
+
+    data.timeBuffer = (float*) fftwf_malloc(sizeof(float)*data.N);
+    data.freqBuffer = (fftwf_complex*) fftwf_malloc(sizeof(fftwf_complex)*(data.N/2 + 1));
+    data.planForward = fftwf_plan_dft_r2c_1d(data.N, data.timeBuffer, data.freqBuffer, FFTW_ESTIMATE);
+    data.planBackward = fftwf_plan_dft_c2r_1d(data.N, data.freqBuffer, data.timeBuffer, FFTW_ESTIMATE);
+
+    data.initialized = true;
+
+    reset();
+
+    return true;
+}
+
+int OFDM::getSamplesPerSymbol() const {
+    return _data->N + _data->nCyclicPrefix;
+}
+
+int OFDM::getBytesPerSymbol() const {
+    return _data->nBytesPerSymbol;
+}
+
+int OFDM::getNumCarriers() const {
+    return _data->binEnd - _data->binStart;
+}
+
+void OFDM::encodePacket(const std::uint8_t * src, int nSymbols, std::vector<float> & samples) {
+    auto & data = *_data;
+
+    samples.clear();
+    if (data.initialized == false || nSymbols <= 0 || nSymbols > kMaxSymbolsPerPacket) return;
+
+    samples.reserve((nSymbols + 2)*(data.N + data.nCyclicPrefix));
+
+    // training symbol
+    data.clearSpectrum();
+    for (int bin = data.binStart; bin < data.binEnd; ++bin) {
+        data.setBin(bin, data.trainingValues[bin - data.binStart]);
+    }
+    data.appendSymbol(samples);
+
+    // header symbol - symbol count and its complement, repeated over the data carriers, same bit on I and Q
+    const float a = 1.0f/std::sqrt(2.0f);
+    uint32_t header = (nSymbols & 0xFFFF) | ((~nSymbols & 0xFFFF) << 16);
+    data.clearSpectrum();
+    data.setPilots();
+    for (int d = 0; d < (int) data.dataBins.size(); ++d) {
+        float v = data.headerScrambler[d]*(((header >> (d%kHeaderBits)) & 1) ? -a : a);
+        data.setBin(data.dataBins[d], TComplex(v, v));
+    }
+    if (data.reducePAPR) data.clipAndFilter();
+    data.appendSymbol(samples);
+
+    // data symbols - QPSK, 2 bits per data carrier
+    for (int s = 0; s < nSymbols; ++s) {
+        const std::uint8_t * cur = src + s*data.nBytesPerSymbol;
+
+        data.clearSpectrum();
+        data.setPilots();
+        for (int d = 0; d < (int) data.dataBins.size(); ++d) {
+            int bit = 2*d;
+            float re = ((cur[bit/8] >> (bit%8)) & 1) ? -a : a;
+            ++bit;
+            float im = ((cur[bit/8] >> (bit%8)) & 1) ? -a : a;
+            data.setBin(data.dataBins[d], TComplex(re, im));
+        }
+        if (data.reducePAPR) data.clipAndFilter();
+        data.appendSymbol(samples);
+    }
+
+    float peak = 0.0f;
+    for (auto s : samples) peak = std::max(peak, std::fabs(s));
+    if (peak > 0.0f) {
+        for (auto & s : samples) s /= peak;
+    }
+
+    int nRamp = std::min(kEdgeRampSamples, (int) samples.size()/2);
+    for (int i = 0; i < nRamp; ++i) {
+        float w = 0.5f - 0.5f*std::cos(M_PI*(i + 0.5f)/nRamp);
+        samples[i] *= w;
+        samples[samples.size() - 1 - i] *= w;
+    }
+}
+
+void OFDM::decode(const float * samples, int n, const SymbolCallback & callback) {
+    auto & data = *_data;
+
+    if (data.initialized == false) return;
+
+    data.rx.insert(data.rx.end(), samples, samples + n);
+
+    while (true) {
+        if (data.state == Data::Searching) {
+            bool found = false;
+            while (data.searchPos + data.N <= data.rxEnd()) {
+                if (data.searchStep()) {
+                    found = true;
+                    break;
+                }
+            }
+            if (found == false) break;
+
+            data.state = Data::Training;
+            continue;
+        }
+
+        if (data.symbolStart + data.N > data.rxEnd()) break;
+
+        data.analyzeSymbol(data.symbolStart);
+
+        long long nextStart = data.symbolStart + data.N + data.nCyclicPrefix;
+
+        switch (data.state) {
+            case Data::Training:
+                {
+                    data.estimateChannel();
+                    data.state = Data::Header;
+                }
+                break;
+            case Data::Header:
+                {
+                    int count = 0;
+                    if (data.decodeHeader(count)) {
+                        data.nSymbols = count;
+                        data.symbolId = 0;
+                        data.state = Data::Payload;
+                    } else {
+                        // false trigger - resume the search right after the plateau
+                        data.restartSearch(data.symbolStart - data.N - data.nCyclicPrefix/2 + 1);
+                        continue;
+                    }
+                }
+                break;
+            case Data::Payload:
+                {
+                    data.decodePayload();
+                    callback(data.symbolId, data.nSymbols, data.symbolData.data());
+                    if (++data.symbolId == data.nSymbols) {
+                        data.restartSearch(nextStart);
+                        continue;
+                    }
+                }
+                break;
+            case Data::Searching:
+                break;
+        };
+
+        data.symbolStart = nextStart;
+    }
+
+    data.trim();
+}
+
+float OFDM::getSNR_dB() const {
+    return _data->snr_dB;
+}
+
+bool OFDM::isReceiving() const {
+    return _data->state == Data::Header || _data->state == Data::Payload;
+}
+
+void OFDM::reset() {
+    auto & data = *_data;
+
+    data.rx.clear();
+    data.rxOffset = 0;
+    data.symbolStart = 0;
+    data.nSymbols = 0;
+    data.symbolId = 0;
+    data.restartSearch(0);
+}
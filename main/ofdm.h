@@ -0,0 +1,51 @@
+/*! \file ofdm.h
+ *  \brief OFDM modem with cyclic prefix and pilot-based equalization
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+class OFDM {
+public:
+    struct Parameters {
+        int samplesPerFrame = 1024;
+        int nCyclicPrefix = 256;
+        int binStart = 40;
+        // multiple of 16, at least 64 - one data carrier per bit of the 32-bit header
+        int nBitsPerSymbol = 256;
+
+        // iterative clip-and-filter of the header and data symbols
+        bool reducePAPR = false;
+    };
+
+    // called for every decoded data symbol of a packet (getBytesPerSymbol() bytes)
+    using SymbolCallback = std::function<void(int symbolId, int nSymbols, const std::uint8_t * data)>;
+
+    OFDM();
+    ~OFDM();
+
+    bool init(const Parameters & params);
+
+    int getSamplesPerSymbol() const;
+    int getBytesPerSymbol() const;
+    int getNumCarriers() const;
+
+    // packet = training symbol + header symbol + nSymbols data symbols, normalized to unit peak
+    void encodePacket(const std::uint8_t * data, int nSymbols, std::vector<float> & samples);
+
+    // feed captured samples; decoded data symbols are reported through the callback
+    void decode(const float * samples, int n, const SymbolCallback & callback);
+    bool isReceiving() const;
+    // estimated from the constellation error of the last decoded data symbol
+    float getSNR_dB() const;
+    void reset();
+
+private:
+    struct Data;
+    std::unique_ptr<Data> _data;
+};
@@ -0,0 +1,75 @@
+/*! \file rate_control.cpp
+ *  \brief Picks the fastest protocol profile that the measured link quality can sustain
+ *  \author Georgi Gerganov
+ */
+
+#include "rate_control.h"
+
+#include <algorithm>
+
+namespace {
+    // smoothing of the per-frame measurements
+    constexpr float kAlpha = 0.25f;
+
+    // step down as soon as the link starts losing frames or running out of ECC margin
+    constexpr int kMaxFailures = 2;
+    constexpr float kMaxECCUsage = 0.5f;
+
+    // step up only after a run of clean frames with plenty of margin left
+    constexpr int kMinGoodFrames = 16;
+    constexpr float kMaxECCUsageUp = 0.1f;
+}
+
+RateControl::RateControl() {
+    reset();
+}
+
+void RateControl::reset() {
+    _snr_dB = 0.0f;
+    _eccUsage = 0.0f;
+    _nFrames = 0;
+    _nFailures = 0;
+    _nGoodFrames = 0;
+}
+
+void RateControl::addFrame(float snr_dB, float eccUsage) {
+    if (_nFrames == 0) {
+        _snr_dB = snr_dB;
+        _eccUsage = eccUsage;
+    } else {
+        _snr_dB += kAlpha*(snr_dB - _snr_dB);
+        _eccUsage += kAlpha*(eccUsage - _eccUsage);
+    }
+
+    ++_nFrames;
+    ++_nGoodFrames;
+}
+
+void RateControl::addFailure() {
+    ++_nFailures;
+    _nGoodFrames = 0;
+}
+
+int RateControl::getRecommendedStep(int currentStepId) const {
+    if (currentStepId < 0) return -1;
+
+    if (_nFailures >= kMaxFailures || (_nFrames > 0 && _eccUsage > kMaxECCUsage)) {
+        return std::max(0, currentStepId - 1);
+    }
+
+    if (currentStepId + 1 < ::Data::Constants::kRateLadderSize &&
+        _nGoodFrames >= kMinGoodFrames && _eccUsage < kMaxECCUsageUp &&
+        _snr_dB >= ::Data::StateInput::rateLadder[currentStepId + 1].minSNR_dB) {
+        return currentStepId + 1;
+    }
+
+    return currentStepId;
+}
+
+void RateControl::getLinkQuality(int currentStepId, ::Data::LinkQuality & quality) const {
+    quality.snr_dB = _snr_dB;
+    quality.eccUsage = _eccUsage;
+    quality.nFrames = _nFrames;
+    quality.nFailures = _nFailures;
+    quality.recommendedStepId = getRecommendedStep(currentStepId);
+}
@@ -0,0 +1,32 @@
+/*! \file rate_control.h
+ *  \brief Picks the fastest protocol profile that the measured link quality can sustain
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include "data.h"
+
+class RateControl {
+public:
+    RateControl();
+
+    void reset();
+
+    // a received frame: estimated SNR and the fraction of the RS correction capacity it used
+    void addFrame(float snr_dB, float eccUsage);
+    // a Tx that was heard but could not be decoded
+    void addFailure();
+
+    // ladder step of StateInput::rateLadder that the link should move to from the current one
+    int getRecommendedStep(int currentStepId) const;
+
+    void getLinkQuality(int currentStepId, ::Data::LinkQuality & quality) const;
+
+private:
+    float _snr_dB;
+    float _eccUsage;
+    int _nFrames;
+    int _nFailures;
+    int _nGoodFrames;
+};
@@ -0,0 +1,154 @@
+/*! \file rs_bench.cpp
+ *  \brief Reed-Solomon decode throughput for the (message, ECC) sizes of the protocol profiles
+ *  \author Georgi Gerganov
+ */
+
+#include "ecc.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    // same shapes as the dispatch table in ecc.cpp
+    struct Shape {
+        int nMsgBytes;
+        int nECCBytes;
+    };
+
+    const Shape kShapes[] = {
+        {  2, 4 }, {  4, 4 }, {  5, 4 }, {  8, 4 }, { 12, 4 }, { 20, 4 }, { 28, 4 },
+    };
+
+    constexpr int kCodewords = 1024;
+    constexpr double kMinSeconds = 0.25;
+
+    // kCodewords codewords with nErrors corrupted symbols each, at distinct random positions - the original
+    // messages go to msgs
+    std::vector<std::uint8_t> makeCodewords(const RS::Codec & codec, int nErrors, std::mt19937 & rng, std::vector<std::uint8_t> & msgs) {
+        int n = codec.MsgLength() + codec.EccLength();
+        std::vector<std::uint8_t> res(kCodewords*n);
+        std::vector<int> pos(n);
+
+        msgs.resize(kCodewords*codec.MsgLength());
+        for (int i = 0; i < kCodewords; ++i) {
+            std::uint8_t * cw = res.data() + i*n;
+            std::uint8_t * msg = msgs.data() + i*codec.MsgLength();
+            for (int k = 0; k < codec.MsgLength(); ++k) msg[k] = rng();
+            codec.Encode(msg, cw);
+
+            for (int k = 0; k < n; ++k) pos[k] = k;
+            std::shuffle(pos.begin(), pos.end(), rng);
+            for (int k = 0; k < nErrors; ++k) {
+                cw[pos[k]] ^= 1 + rng()%255;
+            }
+        }
+
+        return res;
+    }
+
+    // codewords decoded to something else than their original message
+    int getMismatches(const std::vector<std::uint8_t> & decoded, const std::vector<std::uint8_t> & msgs, int nMsgBytes) {
+        int nMismatches = 0;
+        for (int i = 0; i < kCodewords; ++i) {
+            if (memcmp(decoded.data() + i*nMsgBytes, msgs.data() + i*nMsgBytes, nMsgBytes) != 0) ++nMismatches;
+        }
+        return nMismatches;
+    }
+
+    // decode() decodes all kCodewords codewords and returns the number of failures
+    template <typename Decode>
+    double getDecodesPerSecond(Decode && decode, int & nFailed) {
+        using Clock = std::chrono::steady_clock;
+
+        long nDecodes = 0;
+        nFailed = 0;
+        auto tStart = Clock::now();
+        double elapsed = 0.0;
+        do {
+            nFailed = decode();
+            nDecodes += kCodewords;
+            elapsed = std::chrono::duration<double>(Clock::now() - tStart).count();
+        } while (elapsed < kMinSeconds);
+
+        return nDecodes/elapsed;
+    }
+}
+
+int main(int argc, char ** argv) {
+    printf("Usage: %s [msg ecc]\n", argv[0]);
+    printf("    Decodes per second of the runtime, the profile and the batched profile codec at 0, t/2 and t symbol errors\n\n");
+
+    std::vector<Shape> shapes(std::begin(kShapes), std::end(kShapes));
+    if (argc >= 3) {
+        shapes = { { atoi(argv[1]), atoi(argv[2]) } };
+    }
+
+    std::mt19937 rng(1234);
+
+    printf("%4s %4s %7s %16s %16s %16s\n", "msg", "ecc", "errors", "runtime [1/s]", "profile [1/s]", "batch [1/s]");
+    for (const auto & shape : shapes) {
+        if (shape.nMsgBytes <= 0 || shape.nECCBytes <= 0 || shape.nMsgBytes + shape.nECCBytes > 255) {
+            fprintf(stderr, "Invalid shape (%d, %d)\n", shape.nMsgBytes, shape.nECCBytes);
+            continue;
+        }
+
+        RS::ReedSolomon rs(shape.nMsgBytes, shape.nECCBytes);
+        RS::ReedSolomon::Workspace ws(rs);
+        auto codec = ::makeReedSolomon(shape.nMsgBytes, shape.nECCBytes);
+
+        int n = shape.nMsgBytes + shape.nECCBytes;
+        int m = shape.nMsgBytes;
+        std::vector<std::uint8_t> msgs;
+        std::vector<std::uint8_t> decodedRuntime(kCodewords*m);
+        std::vector<std::uint8_t> decodedProfile(kCodewords*m);
+        std::vector<std::uint8_t> decodedBatch(kCodewords*m);
+        int t = shape.nECCBytes/2;
+        for (int nErrors : { 0, t/2, t }) {
+            auto codewords = makeCodewords(*codec, nErrors, rng, msgs);
+            std::fill(decodedRuntime.begin(), decodedRuntime.end(), 0);
+            std::fill(decodedProfile.begin(), decodedProfile.end(), 0);
+            std::fill(decodedBatch.begin(), decodedBatch.end(), 0);
+
+            int nFailedRuntime = 0;
+            int nFailedProfile = 0;
+            int nFailedBatch = 0;
+            double runtime = getDecodesPerSecond([&]() {
+                int nFailed = 0;
+                for (int i = 0; i < kCodewords; ++i) {
+                    if (rs.Decode(ws, codewords.data() + i*n, decodedRuntime.data() + i*m) != 0) ++nFailed;
+                }
+                return nFailed;
+            }, nFailedRuntime);
+            double profile = getDecodesPerSecond([&]() {
+                int nFailed = 0;
+                for (int i = 0; i < kCodewords; ++i) {
+                    if (codec->Decode(codewords.data() + i*n, decodedProfile.data() + i*m) != 0) ++nFailed;
+                }
+                return nFailed;
+            }, nFailedProfile);
+            double batch = getDecodesPerSecond([&]() {
+                return (int) codec->DecodeBatch(codewords.data(), decodedBatch.data(), kCodewords);
+            }, nFailedBatch);
+
+            // a decode that reports success with the wrong bytes is a failure too
+            int nWrongRuntime = getMismatches(decodedRuntime, msgs, m);
+            int nWrongProfile = getMismatches(decodedProfile, msgs, m);
+            int nWrongBatch = getMismatches(decodedBatch, msgs, m);
+
+            printf("%4d %4d %7d %16.0f %16.0f %16.0f\n", shape.nMsgBytes, shape.nECCBytes, nErrors, runtime, profile, batch);
+            if (nFailedRuntime > 0 || nFailedProfile > 0 || nFailedBatch > 0) {
+                fprintf(stderr, "    %d / %d / %d decodes failed\n", nFailedRuntime, nFailedProfile, nFailedBatch);
+            }
+            if (nWrongRuntime > 0 || nWrongProfile > 0 || nWrongBatch > 0) {
+                fprintf(stderr, "    %d / %d / %d codewords decoded to the wrong message\n", nWrongRuntime, nWrongProfile, nWrongBatch);
+            }
+        }
+    }
+
+    return 0;
+}
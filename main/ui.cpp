@@ -6,6 +6,7 @@
 #include "ui.h"
 
 #include "data.h"
+#include "convolutional.h"
 
 #include "cg_logger.h"
 #include "cg_window2d.h"
@@ -44,6 +45,10 @@ struct UI::Data {
     std::weak_ptr<::Data::StateData> stateData;
     std::shared_ptr<::Data::StateData> stateDataLocked;
 
+    // editable copy of the last received snapshot
+    int receivedVersion = -1;
+    std::array<char, ::Data::Constants::kMaxDataSize> receivedData;
+
     std::map<Event, std::function<void()>> callbacks;
 };
 
@@ -246,22 +251,76 @@ void UI::renderWindowControls() const {
 
         {
             static int cid = 3;
-            if (ImGui::Combo("Tx. Protocol", &cid, ::Data::StateInput::configNames, ::Data::StateInput::ConfigId::COUNT)) {
+            bool changed = ImGui::Combo("Tx. Protocol", &cid, ::Data::StateInput::configNames, ::Data::StateInput::ConfigId::COUNT);
+
+            // follow the profile that both ends of the link agreed on
+            static int nRateChanges = 0;
+            if (nRateChanges != data->nRateChanges && data->sendingDataBuffer == false) {
+                nRateChanges = data->nRateChanges;
+                if (inp->useRateAdaptation && data->rateStepId >= 0) {
+                    cid = ::Data::StateInput::rateLadder[data->rateStepId].configId;
+                    changed = (cid != inp->configId);
+                }
+            }
+
+            if (changed) {
                 auto oldVol = inp->sendVolume;
                 auto oldSendData = inp->sendData;
+                auto oldSendFilePath = inp->sendFilePath;
+                auto oldReceiveFilePath = inp->receiveFilePath;
+                auto oldUseCompression = inp->useCompression;
+                auto oldUseRateAdaptation = inp->useRateAdaptation;
+                auto oldUseInterleaving = inp->useInterleaving;
+                auto oldTxPerBlock = inp->nTxPerBlock;
+                auto oldParityTxPerBlock = inp->nParityTxPerBlock;
+                auto oldUseFountain = inp->useFountain;
+                auto oldFountainOverhead = inp->fountainOverhead;
+                auto oldUseInnerCode = inp->useInnerCode;
+                auto oldUseFraming = inp->useFraming;
+                auto oldUseArq = inp->useArq;
                 *inp = ::Data::StateInput::getDefaultConfig((::Data::StateInput::ConfigId)cid);
                 inp->sendVolume = oldVol;
                 inp->sendData = oldSendData;
+                inp->sendFilePath = oldSendFilePath;
+                inp->receiveFilePath = oldReceiveFilePath;
+                inp->useCompression = oldUseCompression;
+                inp->useRateAdaptation = oldUseRateAdaptation;
+                inp->useInterleaving = oldUseInterleaving;
+                inp->nTxPerBlock = oldTxPerBlock;
+                inp->nParityTxPerBlock = oldParityTxPerBlock;
+                inp->useFountain = oldUseFountain;
+                inp->fountainOverhead = oldFountainOverhead;
+                inp->useInnerCode = oldUseInnerCode;
+                inp->useFraming = oldUseFraming;
+                inp->useArq = oldUseArq;
 
                 if (auto & c = _data->callbacks[BUTTON_DATA_ON]) c();
                 if (auto & c = _data->callbacks[BUTTON_DATA_OFF]) c();
             }
         }
 
+        {
+            ImGui::Checkbox("Rate adaptation", &inp->useRateAdaptation) && (updateSendParameters = true);
+            ImGui::SameLine();
+            if (ImGui::Button("Send link report")) {
+                if (auto & c = _data->callbacks[BUTTON_DATA_ON]) c();
+                if (auto & c = _data->callbacks[BUTTON_LINK_REPORT]) c();
+            }
+
+            const auto & quality = data->linkQuality;
+            ImGui::Text("Link: SNR %4.1f dB, ECC usage %3.0f%%, %d frames, %d failed",
+                        quality.snr_dB, 100.0f*quality.eccUsage, quality.nFrames, quality.nFailures);
+            if (quality.recommendedStepId >= 0) {
+                ImGui::Text("Suggested profile: %s", ::Data::StateInput::configNames[::Data::StateInput::rateLadder[quality.recommendedStepId].configId]);
+            } else {
+                ImGui::Text("Suggested profile: - (not on the adaptive ladder)");
+            }
+        }
+
         {
             int idx = std::round(inp->freqDelta_hz/inp->getHzPerFrame());
             ImGui::PushItemWidth(80);
-            if (ImGui::SliderInt("##freqDelta", &idx, 2, 32)) {
+            if (ImGui::SliderInt("##freqDelta", &idx, 1, 32)) {
                 inp->freqDelta_hz = idx*inp->getHzPerFrame();
                 updateSendParameters = true;
             }
@@ -280,9 +339,9 @@ void UI::renderWindowControls() const {
             ImGui::SameLine();
             ImGui::Text("Freq. Start [Hz] = %4.4f", inp->freqStart_hz);
 
-            if ((inp->freqCheck_hz <= inp->freqStart_hz + (inp->nDataBitsPerTx - 1)*inp->freqDelta_hz &&
+            if ((inp->freqCheck_hz < inp->freqStart_hz + inp->getDataBandwidth_hz() &&
                  inp->freqCheck_hz >= inp->freqStart_hz) ||
-                (inp->freqCheck_hz + (::Data::Constants::kMaxBitsPerChecksum - 1)*inp->freqDelta_hz >= inp->freqStart_hz &&
+                (inp->freqCheck_hz + (::Data::Constants::kMaxBitsPerChecksum - 1)*inp->getFreqDeltaChecksum_hz() >= inp->freqStart_hz &&
                  inp->freqCheck_hz <= inp->freqStart_hz)) {
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "(!)");
@@ -308,9 +367,17 @@ void UI::renderWindowControls() const {
 
         ImGui::Checkbox("Encode DataId Parity", &inp->encodeIdParity);
         ImGui::Checkbox("Use checksum", &inp->useChecksum);
+        ImGui::Checkbox("PAPR reduction", &inp->usePAPRReduction) && (updateSendParameters = true);
+        ImGui::Checkbox("Compress payload", &inp->useCompression);
         ImGui::SliderFloat("Volume", &inp->sendVolume, 0.0f, 1.0f);
         ImGui::SliderInt("Ramp Begin/End", &inp->nRampFramesBegin, 1, 256); inp->nRampFramesEnd = inp->nRampFramesBegin;
         ImGui::SliderInt("Ramp Blend", &inp->nRampFramesBlend, 1, 256);
+        {
+            int shape = inp->rampShape;
+            if (ImGui::Combo("Ramp Shape", &shape, ::Data::StateInput::rampShapeNames, ::Data::StateInput::Ramp_COUNT)) {
+                inp->rampShape = (::Data::StateInput::RampShape) shape;
+            }
+        }
         ImGui::SliderInt("nSF Confirm", &inp->nConfirmFrames, 3, 64);
         ImGui::SliderInt("nSF per Data", &inp->subFramesPerTx, 1, 256);
         {
@@ -319,6 +386,47 @@ void UI::renderWindowControls() const {
                 inp->nDataBitsPerTx = 8*idx;
             }
             ImGui::SliderInt("EEC Bytes", &inp->nECCBytesPerTx, 0, 31);
+            ImGui::Checkbox("Convolutional inner code", &inp->useInnerCode) && (updateSendParameters = true);
+            ImGui::Checkbox("Interleave Tx", &inp->useInterleaving) && (updateSendParameters = true);
+            if (inp->useInterleaving) {
+                ImGui::SliderInt("Tx per block", &inp->nTxPerBlock, 2, 255) && (updateSendParameters = true);
+                ImGui::SliderInt("Parity Tx per block", &inp->nParityTxPerBlock, 1, inp->nTxPerBlock - 1) && (updateSendParameters = true);
+                inp->nParityTxPerBlock = std::min(inp->nParityTxPerBlock, inp->nTxPerBlock - 1);
+            }
+            ImGui::Checkbox("Framing (sequence numbers, CRC-32)", &inp->useFraming) && (updateSendParameters = true);
+            if (inp->useFraming) {
+                ImGui::Checkbox("Selective-repeat ARQ", &inp->useArq) && (updateSendParameters = true);
+            }
+            ImGui::Checkbox("Fountain broadcast", &inp->useFountain) && (updateSendParameters = true);
+            if (inp->useFountain) {
+                ImGui::SliderFloat("Fountain overhead", &inp->fountainOverhead, 0.0f, 4.0f) && (updateSendParameters = true);
+            }
+            {
+                int mod = inp->modulation;
+                if (ImGui::Combo("Modulation", &mod, ::Data::StateInput::modulationNames, ::Data::StateInput::Mod_COUNT)) {
+                    inp->modulation = (::Data::StateInput::Modulation) mod;
+                    updateSendParameters = true;
+                }
+            }
+            if (ImGui::SliderInt("Bits per tone", &inp->nBitsPerTone, 1, ::Data::Constants::kMaxBitsPerTone)) {
+                updateSendParameters = true;
+            }
+            if (inp->modulation == ::Data::StateInput::Mod_OFDM) {
+                if (ImGui::SliderInt("Cyclic Prefix", &inp->nCyclicPrefix, 0, inp->samplesPerFrame/2)) {
+                    updateSendParameters = true;
+                }
+            }
+            if (inp->modulation == ::Data::StateInput::Mod_FSK &&
+                (inp->nDataBitsPerTx % inp->nBitsPerTone != 0 || inp->freqDelta_hz < (1 << inp->nBitsPerTone)*inp->getHzPerFrame())) {
+                ImGui::SameLine();
+                ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "(!)");
+                if (ImGui::IsItemHovered()) {
+                    ImGui::BeginTooltip();
+                    ImGui::Text("Bits per Tx must be a multiple of the bits per tone and\n");
+                    ImGui::Text("Freq. Delta must cover all tones of a group\n");
+                    ImGui::EndTooltip();
+                }
+            }
         }
 
         ImGui::Checkbox("1##dataBit0", &inp->dataBits[0]) && (updateSendParameters = true); ImGui::SameLine();
@@ -353,11 +461,35 @@ void UI::renderWindowControls() const {
             if (auto & c = _data->callbacks[BUTTON_DATA_OFF]) c();
         }
 
-        ImGui::Text("Tx duration: %4.4f ms", inp->subFramesPerTx*subFrameLength_ms);
-        ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Bandwidth:   %4.2f B/s",
-                           (inp->nDataBitsPerTx/8 > inp->nECCBytesPerTx) ?
-                           1000.0/(inp->subFramesPerTx*subFrameLength_ms)*(inp->nDataBitsPerTx/8.0 - inp->nECCBytesPerTx) :
-                           1000.0/(inp->subFramesPerTx*subFrameLength_ms)*inp->nDataBitsPerTx/8.0);
+        {
+            // an OFDM symbol carries a full Tx worth of data
+            float txLength_ms = (inp->modulation == ::Data::StateInput::Mod_OFDM) ?
+                1000.0f*(inp->samplesPerFrame + inp->nCyclicPrefix)/inp->sampleRate :
+                inp->subFramesPerTx*subFrameLength_ms;
+
+            ImGui::Text("Tx duration: %4.4f ms", txLength_ms);
+
+            // the inner code leaves a bit less than half of the Tx to the RS codeword
+            bool isToneMod = inp->modulation != ::Data::StateInput::Mod_OFDM;
+            int nCodewordBytes = (inp->useInnerCode && isToneMod) ? ConvolutionalCode::getInfoBytes(inp->nDataBitsPerTx) : inp->nDataBitsPerTx/8;
+            if (inp->useInterleaving && isToneMod) {
+                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Bandwidth:   %4.2f B/s",
+                                   1000.0/txLength_ms*nCodewordBytes*(inp->nTxPerBlock - inp->nParityTxPerBlock)/inp->nTxPerBlock);
+            } else if (inp->useFountain && isToneMod) {
+                // 3 bytes of symbol header per Tx, the overhead symbols only add robustness
+                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Bandwidth:   %4.2f B/s",
+                                   1000.0/txLength_ms*std::max(0, nCodewordBytes - inp->nECCBytesPerTx - 3)/(1.0 + inp->fountainOverhead));
+            } else if (inp->useFraming && isToneMod) {
+                // one more header byte per Tx than a plain chunk, the 8-byte trailer is per message
+                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Bandwidth:   %4.2f B/s",
+                                   1000.0/txLength_ms*std::max(0, nCodewordBytes - inp->nECCBytesPerTx - 1));
+            } else {
+                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Bandwidth:   %4.2f B/s",
+                                   (nCodewordBytes > inp->nECCBytesPerTx) ?
+                                   1000.0/txLength_ms*(nCodewordBytes - inp->nECCBytesPerTx) :
+                                   1000.0/txLength_ms*nCodewordBytes);
+            }
+        }
     }
 
     ImGui::End();
@@ -377,15 +509,18 @@ void UI::renderWindowInput() const {
     histSize.y *= 0.60;
     ImGui::BeginChild("##histograms", histSize);
 
-    if (data->sampleAmplitude != nullptr) {
+    // the snapshot stays the same for the whole frame, whatever the worker does meanwhile
+    const auto frame = data->frame;
+
+    if (frame != nullptr) {
         auto wSize = ImGui::GetContentRegionAvail();
         wSize.y *= 0.333;
-        ImGui::PlotLines("##plotWaveform", data->sampleAmplitude->data(), data->samplesPerFrame, 0, "Waveform", -0.2f, 0.2f, wSize);
+        ImGui::PlotLines("##plotWaveform", frame->sampleAmplitude.data(), data->samplesPerFrame, 0, "Waveform", -0.2f, 0.2f, wSize);
     } else {
         ImGui::TextColored({ 1.0f, 0.0f, 0.0f, 1.0f }, "Audio not initialized yet!");
     }
 
-    if (data->sampleSpectrum != nullptr) {
+    if (frame != nullptr) {
         auto wSize = ImGui::GetContentRegionAvail();
         wSize.y *= 0.5;
         static float yScale = 1.0f;
@@ -397,10 +532,10 @@ void UI::renderWindowInput() const {
                              [](void *data, int i) -> float {
                                  if (data == nullptr ||
                                      i*::g_inp->getHzPerFrame() < ::g_inp->freqStart_hz ||
-                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqStart_hz + ::g_inp->nDataBitsPerTx*::g_inp->freqDelta_hz) return 0.0f;
+                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqStart_hz + ::g_inp->getDataBandwidth_hz()) return 0.0f;
                                  return 1.0f;
                              },
-                             data->sampleSpectrum->data(), data->samplesPerFrame/2, 0, "\nGreen: Data, Red: Checksum", 0.5f, 1.0f, wSize);
+                             frame->sampleSpectrum.data(), data->samplesPerFrame/2, 0, "\nGreen: Data, Red: Checksum", 0.5f, 1.0f, wSize);
         ImGui::PopStyleColor(2);
 
         ImGui::SetCursorScreenPos(posSave);
@@ -410,20 +545,20 @@ void UI::renderWindowInput() const {
                              [](void *data, int i) -> float {
                                  if (data == nullptr ||
                                      i*::g_inp->getHzPerFrame() < ::g_inp->freqCheck_hz ||
-                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqCheck_hz + ::Data::Constants::kMaxBitsPerChecksum*::g_inp->freqDelta_hz) return 0.0f;
+                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqCheck_hz + ::Data::Constants::kMaxBitsPerChecksum*::g_inp->getFreqDeltaChecksum_hz()) return 0.0f;
                                  return 1.0f;
                              },
-                             data->sampleSpectrum->data(), data->samplesPerFrame/2, 0, NULL, 0.5f, 1.0f, wSize);
+                             frame->sampleSpectrum.data(), data->samplesPerFrame/2, 0, NULL, 0.5f, 1.0f, wSize);
         ImGui::PopStyleColor(2);
 
         ImGui::SetCursorScreenPos(posSave);
-        ImGui::PlotHistogram("##plotSpectrumCurrent", data->sampleSpectrum->data(), data->samplesPerFrame/2, 0,
+        ImGui::PlotHistogram("##plotSpectrumCurrent", frame->sampleSpectrum.data(), data->samplesPerFrame/2, 0,
                 (std::string("Current Spectrum, Y max = ") + std::to_string(yScale)).c_str(), 0.0f, yScale, wSize);
 
         ImGui::IsItemHovered() && (yScale *= (1.0 + 0.01*ImGui::GetIO().MouseWheel));
     }
 
-    if (data->historySpectrumAverage != nullptr) {
+    if (frame != nullptr) {
         auto wSize = ImGui::GetContentRegionAvail();
         wSize.y *= 1.0;
         static float yScale = 1.0f;
@@ -435,10 +570,10 @@ void UI::renderWindowInput() const {
                              [](void *data, int i) -> float {
                                  if (data == nullptr ||
                                      i*::g_inp->getHzPerFrame() < ::g_inp->freqStart_hz ||
-                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqStart_hz + ::g_inp->nDataBitsPerTx*::g_inp->freqDelta_hz) return 0.0f;
+                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqStart_hz + ::g_inp->getDataBandwidth_hz()) return 0.0f;
                                  return 1.0f;
                              },
-                             data->sampleSpectrum->data(), data->samplesPerFrame/2, 0, "\nGreen: Data, Red: Checksum", 0.5f, 1.0f, wSize);
+                             frame->sampleSpectrum.data(), data->samplesPerFrame/2, 0, "\nGreen: Data, Red: Checksum", 0.5f, 1.0f, wSize);
         ImGui::PopStyleColor(2);
 
         ImGui::SetCursorScreenPos(posSave);
@@ -448,14 +583,14 @@ void UI::renderWindowInput() const {
                              [](void *data, int i) -> float {
                                  if (data == nullptr ||
                                      i*::g_inp->getHzPerFrame() < ::g_inp->freqCheck_hz ||
-                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqCheck_hz + ::Data::Constants::kMaxBitsPerChecksum*::g_inp->freqDelta_hz) return 0.0f;
+                                     i*::g_inp->getHzPerFrame() > ::g_inp->freqCheck_hz + ::Data::Constants::kMaxBitsPerChecksum*::g_inp->getFreqDeltaChecksum_hz()) return 0.0f;
                                  return 1.0f;
                              },
-                             data->sampleSpectrum->data(), data->samplesPerFrame/2, 0, NULL, 0.5f, 1.0f, wSize);
+                             frame->sampleSpectrum.data(), data->samplesPerFrame/2, 0, NULL, 0.5f, 1.0f, wSize);
         ImGui::PopStyleColor(2);
 
         ImGui::SetCursorScreenPos(posSave);
-        ImGui::PlotHistogram("##plotSpectrumAverage", data->historySpectrumAverage->data(), data->samplesPerFrame/2, 0,
+        ImGui::PlotHistogram("##plotSpectrumAverage", frame->historySpectrumAverage.data(), data->samplesPerFrame/2, 0,
                 (std::string("Average Spectrum, Y max = ") + std::to_string(yScale)).c_str(), 0.0f, yScale, wSize);
 
         ImGui::IsItemHovered() && (yScale *= (1.0 + 0.01*ImGui::GetIO().MouseWheel));
@@ -481,18 +616,25 @@ void UI::renderWindowInput() const {
         ImGui::Columns(2, "", false);
         ImGui::SetColumnOffset(1, wSize.y);
         if (data->receivingData) {
-            ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Receiving --->");
+            ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Receiving --->: %d B", data->nBytesReceived);
         } else {
-            ImGui::Text("Received:");
+            ImGui::Text("Received: %d B", data->nBytesReceived);
+        }
+        if (data->nMessagesReceived > 0 || data->nMessagesCorrupted > 0) {
+            ImGui::Text("Messages: %d OK, %d corrupted", data->nMessagesReceived, data->nMessagesCorrupted);
         }
         if (ImGui::Button("Clear", ImVec2(wSize.y, wSize.y - 20))) {
             if (auto & c = _data->callbacks[BUTTON_DATA_CLEAR]) c();
         }
         ImGui::NextColumn();
-        if (data->receivedData) {
+        if (data->received) {
+            if (data->received->version != _data->receivedVersion) {
+                _data->receivedVersion = data->received->version;
+                _data->receivedData = data->received->receivedData;
+            }
             wSize.x = ImGui::GetContentRegionAvailWidth();
             ImGui::PushTextWrapPos(0.0f);
-            ImGui::InputTextMultiline("##dataReceived", data->receivedData->data(), ::Data::Constants::kMaxDataSize, wSize);
+            ImGui::InputTextMultiline("##dataReceived", _data->receivedData.data(), ::Data::Constants::kMaxDataSize, wSize);
             ImGui::PopTextWrapPos();
         }
         ImGui::NextColumn();
@@ -505,13 +647,16 @@ void UI::renderWindowInput() const {
         ImGui::Columns(2, "", false);
         ImGui::SetColumnOffset(1, wSize.y);
         if (data->sendingData) {
-            ImGui::TextColored(ImVec4(0.0f, 1.0f, 1.0f, 1.0f), "Sending   --->:");
+            ImGui::TextColored(ImVec4(0.0f, 1.0f, 1.0f, 1.0f), "Sending   --->: %d B, %d queued", data->nBytesSent, data->nQueuedMessages);
+            if (inp->useArq) {
+                ImGui::Text("Retransmissions: %d", data->nRetransmissions);
+            }
         } else {
             ImGui::Text("To send:");
         }
         static int nBytes = 32;
         ImGui::DragInt("Bytes", &nBytes, 1, 1, 512);
-        if (ImGui::Button("Random", ImVec2(wSize.y, 0.5*(wSize.y - 44)))) {
+        if (ImGui::Button("Random", ImVec2(wSize.y, (1.0/3.0)*(wSize.y - 48)))) {
             inp->sendData.fill(0);
             for (int i = 0; i < nBytes; ++i) {
                 if (i > 0 && (i%32 == 0)) {
@@ -525,13 +670,21 @@ void UI::renderWindowInput() const {
                 }
             }
         }
-        if (ImGui::Button("Send", ImVec2(wSize.y, 0.5*(wSize.y - 44)))) {
+        if (ImGui::Button("Send", ImVec2(wSize.y, (1.0/3.0)*(wSize.y - 48)))) {
             if (auto & c = _data->callbacks[BUTTON_DATA_CLEAR]) c();
             if (auto & c = _data->callbacks[BUTTON_DATA_ON]) c();
             if (auto & c = _data->callbacks[BUTTON_DATA_SEND]) c();
         }
+        if (ImGui::Button("Queue", ImVec2(wSize.y, (1.0/3.0)*(wSize.y - 48)))) {
+            if (data->sendingDataBuffer) {
+                if (auto & c = _data->callbacks[BUTTON_DATA_QUEUE]) c();
+            } else {
+                if (auto & c = _data->callbacks[BUTTON_DATA_ON]) c();
+                if (auto & c = _data->callbacks[BUTTON_DATA_QUEUE]) c();
+            }
+        }
         ImGui::NextColumn();
-        if (data->receivedData) {
+        if (data->received) {
             ImGui::PushTextWrapPos(0.0f);
             ImGui::InputTextMultiline("##dataSend", inp->sendData.data(), ::Data::Constants::kMaxDataSize, ImGui::GetContentRegionAvail());
             ImGui::PopTextWrapPos();
@@ -540,6 +693,20 @@ void UI::renderWindowInput() const {
         ImGui::Columns(1);
     }
 
+    {
+        ImGui::InputText("##sendFilePath", inp->sendFilePath.data(), ::Data::Constants::kMaxFilePath);
+        ImGui::SameLine();
+        if (ImGui::Button("Send file")) {
+            if (auto & c = _data->callbacks[BUTTON_DATA_ON]) c();
+            if (auto & c = _data->callbacks[BUTTON_SEND_FILE]) c();
+        }
+        ImGui::InputText("##receiveFilePath", inp->receiveFilePath.data(), ::Data::Constants::kMaxFilePath);
+        ImGui::SameLine();
+        if (ImGui::Button("Save received to file")) {
+            if (auto & c = _data->callbacks[BUTTON_RECEIVE_FILE]) c();
+        }
+    }
+
     ImGui::End();
 }
 
@@ -550,8 +717,8 @@ void UI::renderWindowOutput() const {
     ImGui::SetNextWindowSize(ImVec2(813, 237), ImGuiSetCond_FirstUseEver);
     ImGui::Begin((std::string("Output##") + ::programId).c_str(), nullptr, _data->windowFlags);
 
-    if (data->bitAmplitude != nullptr) {
-        for (const auto & bAmpl : *data->bitAmplitude) {
+    if (const auto tones = data->tones) {
+        for (const auto & bAmpl : tones->bitAmplitude) {
             auto wSize = ImGui::GetContentRegionAvail();
             wSize.y = 20;
             ImGui::PlotLines("", bAmpl.data(), data->samplesPerFrame, 0, NULL, -1.0f, 1.0f, wSize);
@@ -37,7 +37,11 @@ public:
         BUTTON_DATA_OFF,
         BUTTON_DATA_TAP,
         BUTTON_DATA_SEND,
+        BUTTON_DATA_QUEUE,
         BUTTON_DATA_CLEAR,
+        BUTTON_SEND_FILE,
+        BUTTON_RECEIVE_FILE,
+        BUTTON_LINK_REPORT,
     };
 
     void setEventCallback(Event e, std::function<void()> && callback);
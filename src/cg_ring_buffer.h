@@ -7,6 +7,7 @@
 
 #include <array>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
 namespace CG {
@@ -83,4 +84,106 @@ private:
     std::array<TData, BufferSize> buffer_;
 };
 
+// Wait-free ring for exactly one producer thread (push) and one consumer thread (try_pop / pop).
+// Head and tail are free running and sit on separate cache lines, each side caches the index of the other one
+// and reloads it only when the ring looks full / empty.
+template <class TData, std::size_t BufferSize>
+class SPSCRingBuffer {
+public:
+    static_assert(BufferSize > 0 && (BufferSize & (BufferSize - 1)) == 0, "BufferSize must be a power of 2");
+
+    SPSCRingBuffer() : head_(0), tailCached_(0), tail_(0), headCached_(0) {}
+
+    bool push(const TData& item) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (full(tail)) return false;
+        buffer_[tail & kMask] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(TData && item) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (full(tail)) return false;
+        buffer_[tail & kMask] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pushes as many of the n items as fit and returns their number
+    std::size_t push(const TData * items, std::size_t n) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        std::size_t nFree = BufferSize - (tail - headCached_);
+        if (nFree < n) {
+            headCached_ = head_.load(std::memory_order_acquire);
+            nFree = BufferSize - (tail - headCached_);
+        }
+        if (n > nFree) n = nFree;
+        for (std::size_t i = 0; i < n; ++i) {
+            buffer_[(tail + i) & kMask] = items[i];
+        }
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    bool try_pop(TData& item) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (empty(head)) return false;
+        item = std::move(buffer_[head & kMask]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // pops up to n items and returns their number
+    std::size_t pop(TData * items, std::size_t n) {
+        auto head = head_.load(std::memory_order_relaxed);
+        std::size_t nUsed = tailCached_ - head;
+        if (nUsed < n) {
+            tailCached_ = tail_.load(std::memory_order_acquire);
+            nUsed = tailCached_ - head;
+        }
+        if (n > nUsed) n = nUsed;
+        for (std::size_t i = 0; i < n; ++i) {
+            items[i] = std::move(buffer_[(head + i) & kMask]);
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // exact only on the producer or the consumer thread while the other one is idle
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    static constexpr std::size_t capacity() { return BufferSize; }
+
+private:
+    static constexpr std::size_t kMask = BufferSize - 1;
+    static constexpr std::size_t kCacheLineSize = 64;
+
+    bool full(std::size_t tail) {
+        if (tail - headCached_ < BufferSize) return false;
+        headCached_ = head_.load(std::memory_order_acquire);
+        return tail - headCached_ >= BufferSize;
+    }
+
+    bool empty(std::size_t head) {
+        if (head != tailCached_) return false;
+        tailCached_ = tail_.load(std::memory_order_acquire);
+        return head == tailCached_;
+    }
+
+    // consumer side
+    std::atomic<std::size_t> head_;
+    std::size_t tailCached_;
+    char padHead_[kCacheLineSize - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+    // producer side
+    std::atomic<std::size_t> tail_;
+    std::size_t headCached_;
+    char padTail_[kCacheLineSize - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+    std::array<TData, BufferSize> buffer_;
+};
+
 }
@@ -0,0 +1,56 @@
+/*! \file cg_triple_buffer.h
+ *  \brief Lock-free triple buffer - one writer thread publishes snapshots, one reader thread takes the latest one.
+ *  \author Georgi Gerganov
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace CG {
+
+// The writer fills getWriteBuffer() and publishes it by swapping it with the middle buffer, the reader
+// swaps its buffer with the middle one whenever a newer snapshot has been published. Neither side waits.
+template <class TData>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle_(1), writeId_(0), readId_(2) {}
+
+    // writer thread
+    TData & getWriteBuffer() { return buffers_[writeId_]; }
+
+    // writer thread - the write buffer becomes the latest snapshot, the next one has unspecified contents
+    void publish() {
+        writeId_ = middle_.exchange(writeId_ | kNew, std::memory_order_acq_rel) & kIdMask;
+    }
+
+    // reader thread - returns true if a newer snapshot has been taken
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & kNew) == 0) return false;
+        readId_ = middle_.exchange(readId_, std::memory_order_acq_rel) & kIdMask;
+        return true;
+    }
+
+    // reader thread
+    const TData & getReadBuffer() const { return buffers_[readId_]; }
+
+private:
+    static constexpr int kIdMask = 0x3;
+    static constexpr int kNew = 0x4;
+    static constexpr std::size_t kCacheLineSize = 64;
+
+    // id of the middle buffer and whether it is newer than the one of the reader
+    std::atomic<int> middle_;
+    char padMiddle_[kCacheLineSize - sizeof(std::atomic<int>)];
+
+    int writeId_;
+    char padWrite_[kCacheLineSize - sizeof(int)];
+
+    int readId_;
+    char padRead_[kCacheLineSize - sizeof(int)];
+
+    std::array<TData, 3> buffers_;
+};
+
+}